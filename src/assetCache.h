@@ -0,0 +1,369 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "assetLoader.h"
+#include "deletionQueue.h"
+#include "modelLoader.h"
+#include "texture.h"
+
+#include <unordered_map>
+
+//Общий реестр загруженных текстур и моделей по пути (и раскладке вершин для моделей).
+//Хранит weak_ptr: ресурс жив, пока на него ссылается хоть одна сущность, а после
+//последней ссылки уходит в DeletionQueue и удаляется, когда его не читает ни один кадр
+class AssetCache{
+public:
+    AssetCache(Device* device)
+    {
+        this->device = device;
+    }
+
+    std::shared_ptr<Texture> GetTexture(const std::string& path)
+    {
+        if(auto texture = findTexture(path))
+            return texture;
+
+        TextureData data;
+        AssetLoader::DecodeTexture(path, data);
+
+        return addTexture(path, data);
+    }
+
+    //Картинка уже в памяти (png/jpg), key - уникальное имя, например "scene.glb#0"
+    std::shared_ptr<Texture> GetTexture(const std::string& key, const uint8_t* encoded, size_t size, TextureUsage usage = TextureUsage::Color)
+    {
+        if(auto texture = findTexture(key))
+            return texture;
+
+        TextureData data;
+        AssetLoader::DecodeTextureFromMemory(encoded, size, usage, data);
+
+        return addTexture(key, data);
+    }
+
+    //Уже собранная мип-цепочка, например страница атласа
+    std::shared_ptr<Texture> GetTexture(const std::string& key, const TextureData& data)
+    {
+        if(auto texture = findTexture(key))
+            return texture;
+
+        return addTexture(key, data);
+    }
+
+    //Серая клетка 2x2, пока настоящая картинка грузится
+    std::shared_ptr<Texture> GetPlaceholderTexture()
+    {
+        static const uint8_t pixels[16] = {
+            160, 160, 160, 255,   96, 96, 96, 255,
+            96, 96, 96, 255,      160, 160, 160, 255
+        };
+
+        if(!placeholder)
+        {
+            placeholder = DeletionQueue::MakeShared(new Texture(device));
+            placeholder->Create(pixels, 2, 2);
+        }
+
+        return placeholder;
+    }
+
+    //Если картинка уже есть, onReady вызывается сразу. Одновременные заявки на один путь
+    //разбираются один раз; каждая получает свой handle, отмена снимает только её
+    AssetHandle LoadTextureAsync(AssetLoader& loader, const std::string& path, JobPriority priority, std::function<void(std::shared_ptr<Texture>)> onReady)
+    {
+        return loadAsync<Texture>(textures, pendingTextures, path, onReady, [&]{
+            return loader.LoadTexture(path, priority, [this, path](TextureData& data){
+                if(waiting(pendingTextures, path))
+                    finishPending(pendingTextures, path, addTexture(path, data));
+            }, [this, path]{
+                failPending(pendingTextures, path);
+            });
+        });
+    }
+
+    std::shared_ptr<Model> GetModel(const std::string& path, const VertexLayout& layout)
+    {
+        std::string key = modelKey(path, layout);
+
+        if(auto model = find(models, key))
+            return model;
+
+        Model source(nullptr);
+        ModelLoader::LoadObj(path, source);
+
+        return addModel(key, source, layout);
+    }
+
+    AssetHandle LoadModelAsync(AssetLoader& loader, const std::string& path, const VertexLayout& layout, JobPriority priority, std::function<void(std::shared_ptr<Model>)> onReady)
+    {
+        std::string key = modelKey(path, layout);
+
+        return loadAsync<Model>(models, pendingModels, key, onReady, [&]{
+            return loader.LoadModel(path, priority, [this, key, layout](MeshData& data){
+                if(waiting(pendingModels, key))
+                    finishPending(pendingModels, key, addModel(key, data.model, layout));
+            }, [this, key]{
+                failPending(pendingModels, key);
+            });
+        });
+    }
+
+    //Файл изменился на диске: живая текстура с этого пути перечитывается в фоне и подменяется
+    //на месте. onReloaded получает старый вид, чтобы пайплайны переписали дескрипторы.
+    //false - такой текстуры сейчас нет, перечитывать нечего
+    bool ReloadTexture(AssetLoader& loader, const std::string& path, std::function<void(VkImageView)> onReloaded, std::function<void()> onFailed = nullptr)
+    {
+        if(!isLive(textures, path))
+            return false;
+
+        loader.LoadTexture(path, JobPriority::High, [this, path, onReloaded](TextureData& data){
+            auto it = textures.find(path);
+            std::shared_ptr<Texture> texture = it != textures.end() ? it->second.lock() : nullptr;
+            if(!texture)
+                return;
+
+            Texture* fresh = new Texture(device);
+            fresh->samplerState = texture->samplerState;
+            createTexture(*fresh, data);
+
+            VkImageView old = texture->view;
+            texture->Swap(*fresh);
+            DeletionQueue::Push([fresh]{ delete fresh; });
+
+            onReloaded(old);
+        }, onFailed);
+
+        return true;
+    }
+
+    //То же для моделей: все живые раскладки этого файла получают новую геометрию
+    bool ReloadModel(AssetLoader& loader, const std::string& path, std::function<void(Model*)> onReloaded, std::function<void()> onFailed = nullptr)
+    {
+        std::string prefix = path + "|";
+
+        bool live = false;
+        for(auto& [key, model] : models)
+            if(key.compare(0, prefix.size(), prefix) == 0 && !model.expired())
+                live = true;
+
+        if(!live)
+            return false;
+
+        loader.LoadModel(path, JobPriority::High, [this, prefix, onReloaded](MeshData& data){
+            for(auto& [key, entry] : models)
+            {
+                if(key.compare(0, prefix.size(), prefix) != 0)
+                    continue;
+
+                std::shared_ptr<Model> model = entry.lock();
+                if(!model)
+                    continue;
+
+                Model source(nullptr);
+                source.CopyGeometry(data.model);
+                model->ReplaceGeometry(source);
+
+                onReloaded(model.get());
+            }
+        }, onFailed);
+
+        return true;
+    }
+
+    //Живые записи и попадания в кэш, для отладочного окна
+    size_t GetTextureCount() { return prune(textures); }
+    size_t GetModelCount() { return prune(models); }
+
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+
+private:
+    template<typename T>
+    struct Pending{
+        AssetHandle request;
+        std::vector<std::pair<AssetHandle, std::function<void(std::shared_ptr<T>)>>> waiters;
+    };
+
+    template<typename T>
+    using Entries = std::unordered_map<std::string, std::weak_ptr<T>>;
+
+    template<typename T>
+    using PendingEntries = std::unordered_map<std::string, Pending<T>>;
+
+    template<typename T>
+    std::shared_ptr<T> find(Entries<T>& entries, const std::string& key)
+    {
+        auto it = entries.find(key);
+        if(it == entries.end())
+            return nullptr;
+
+        std::shared_ptr<T> resource = it->second.lock();
+        if(!resource)
+        {
+            entries.erase(it);
+            return nullptr;
+        }
+
+        hits++;
+        return resource;
+    }
+
+    std::shared_ptr<Texture> findTexture(const std::string& key)
+    {
+        return find(textures, key);
+    }
+
+    template<typename T>
+    size_t prune(Entries<T>& entries)
+    {
+        for(auto it = entries.begin(); it != entries.end();)
+        {
+            if(it->second.expired())
+                it = entries.erase(it);
+            else
+                ++it;
+        }
+
+        return entries.size();
+    }
+
+    std::shared_ptr<Texture> addTexture(const std::string& key, const TextureData& data)
+    {
+        misses++;
+
+        std::shared_ptr<Texture> texture = DeletionQueue::MakeShared(new Texture(device));
+        createTexture(*texture, data);
+
+        textures[key] = texture;
+        return texture;
+    }
+
+    static void createTexture(Texture& texture, const TextureData& data)
+    {
+        if(data.compressed.IsValid())
+            texture.Create(data.compressed);
+        else
+            texture.Create(data.pixels.data(), data.width, data.height);
+    }
+
+    template<typename T>
+    static bool isLive(Entries<T>& entries, const std::string& key)
+    {
+        auto it = entries.find(key);
+        return it != entries.end() && !it->second.expired();
+    }
+
+    std::shared_ptr<Model> addModel(const std::string& key, Model& source, const VertexLayout& layout)
+    {
+        misses++;
+
+        std::shared_ptr<Model> model = DeletionQueue::MakeShared(new Model(device));
+        model->layout = layout;
+        model->TakeGeometry(source);
+        model->Init();
+
+        models[key] = model;
+        return model;
+    }
+
+    template<typename T, typename Start>
+    AssetHandle loadAsync(Entries<T>& entries, PendingEntries<T>& pending, const std::string& key, std::function<void(std::shared_ptr<T>)> onReady, Start start)
+    {
+        auto ticket = std::make_shared<AssetRequest>();
+        ticket->path = key;
+
+        if(auto resource = find(entries, key))
+        {
+            onReady(resource);
+            ticket->state = AssetState::Ready;
+            return ticket;
+        }
+
+        auto it = pending.find(key);
+        if(it == pending.end())
+        {
+            it = pending.emplace(key, Pending<T>()).first;
+            it->second.request = start();
+        }
+
+        ticket->state = AssetState::Loading;
+        it->second.waiters.push_back({ticket, onReady});
+
+        return ticket;
+    }
+
+    //Все ждавшие отменили заявку - ресурс не создаём
+    template<typename T>
+    bool waiting(PendingEntries<T>& pending, const std::string& key)
+    {
+        auto it = pending.find(key);
+        if(it == pending.end())
+            return false;
+
+        for(auto& waiter : it->second.waiters)
+            if(!waiter.first->IsCancelled())
+                return true;
+
+        for(auto& waiter : it->second.waiters)
+            waiter.first->state = AssetState::Cancelled;
+
+        pending.erase(it);
+        return false;
+    }
+
+    template<typename T>
+    void finishPending(PendingEntries<T>& pending, const std::string& key, std::shared_ptr<T> resource)
+    {
+        auto it = pending.find(key);
+        if(it == pending.end())
+            return;
+
+        Pending<T> entry = std::move(it->second);
+        pending.erase(it);
+
+        for(auto& [ticket, onReady] : entry.waiters)
+        {
+            if(ticket->IsCancelled())
+            {
+                ticket->state = AssetState::Cancelled;
+                continue;
+            }
+
+            onReady(resource);
+            ticket->state = AssetState::Ready;
+        }
+    }
+
+    template<typename T>
+    void failPending(PendingEntries<T>& pending, const std::string& key)
+    {
+        auto it = pending.find(key);
+        if(it == pending.end())
+            return;
+
+        for(auto& waiter : it->second.waiters)
+        {
+            waiter.first->error = it->second.request->GetError();
+            waiter.first->state = AssetState::Failed;
+        }
+
+        pending.erase(it);
+    }
+
+    static std::string modelKey(const std::string& path, const VertexLayout& layout)
+    {
+        return path + "|" + std::to_string((int)layout.position) + std::to_string((int)layout.normal) +
+               std::to_string((int)layout.color) + std::to_string((int)layout.texCoord) + (layout.splitPositions ? "s" : "");
+    }
+
+    Entries<Texture> textures;
+    Entries<Model> models;
+
+    PendingEntries<Texture> pendingTextures;
+    PendingEntries<Model> pendingModels;
+
+    std::shared_ptr<Texture> placeholder;
+
+    Device* device;
+};
@@ -0,0 +1,240 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "threadPool.h"
+#include "model.h"
+#include "modelLoader.h"
+#include "textureCache.h"
+
+#include <atomic>
+#include <memory>
+
+enum class AssetState{
+    Queued,
+    Loading,
+    Ready,
+    Failed,
+    Cancelled
+};
+
+//Заявка на загрузку; живёт, пока на неё есть ссылки. Отмена до начала разбора
+//снимает работу с потока, отмена после - только не даёт вызвать onReady
+class AssetRequest{
+public:
+    AssetState GetState() const { return state.load(); }
+    bool IsDone() const { return GetState() == AssetState::Ready || GetState() == AssetState::Failed || GetState() == AssetState::Cancelled; }
+
+    void Cancel()
+    {
+        cancelled = true;
+    }
+
+    bool IsCancelled() const { return cancelled.load(); }
+
+    //Заполняется при AssetState::Failed
+    const std::string& GetError() const { return error; }
+
+    const std::string& GetPath() const { return path; }
+
+private:
+    friend class AssetLoader;
+    friend class AssetCache;
+
+    std::string path;
+    std::atomic<AssetState> state{AssetState::Queued};
+    std::atomic<bool> cancelled{false};
+    std::string error;
+
+    //Выполняются в главном потоке, когда данные готовы или разбор не удался
+    std::function<void()> finish;
+    std::function<void()> fail;
+};
+
+using AssetHandle = std::shared_ptr<AssetRequest>;
+
+//Готовая к загрузке мип-цепочка в compressed (BC или RGBA8); pixels - только для
+//картинок, собранных вручную
+struct TextureData{
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+
+    CompressedTexture compressed;
+};
+
+//Геометрия после разбора, сварки и оптимизации, ещё не загруженная в пул
+struct MeshData{
+    Model model{nullptr};
+};
+
+//Разбирает файлы на пуле потоков. Готовые данные копятся в очереди и отдаются
+//в главный поток из Update, где их можно грузить в Vulkan
+class AssetLoader{
+public:
+    AssetLoader(uint32_t threadCount = 0) : pool(threadCount)
+    {
+    }
+
+    template<typename T>
+    AssetHandle Load(const std::string& path, JobPriority priority, std::function<void(const std::string&, T&)> decode, std::function<void(T&)> onReady,
+                     std::function<void()> onFailed = nullptr)
+    {
+        auto request = std::make_shared<AssetRequest>();
+        auto data = std::make_shared<T>();
+
+        request->path = path;
+        request->finish = [data, onReady]{ onReady(*data); };
+        request->fail = onFailed;
+
+        pending++;
+
+        pool.Submit([this, request, data, decode]{
+            if(request->IsCancelled())
+            {
+                complete(request);
+                return;
+            }
+
+            request->state = AssetState::Loading;
+
+            try{
+                decode(request->path, *data);
+            }catch(const std::exception& e){
+                request->error = e.what();
+                request->state = AssetState::Failed;
+            }
+
+            complete(request);
+        }, priority);
+
+        return request;
+    }
+
+    AssetHandle LoadTexture(const std::string& path, JobPriority priority, std::function<void(TextureData&)> onReady, std::function<void()> onFailed = nullptr)
+    {
+        return Load<TextureData>(path, priority, DecodeTexture, onReady, onFailed);
+    }
+
+    AssetHandle LoadModel(const std::string& path, JobPriority priority, std::function<void(MeshData&)> onReady, std::function<void()> onFailed = nullptr)
+    {
+        return Load<MeshData>(path, priority, DecodeModel, onReady, onFailed);
+    }
+
+    //Главный поток, раз в кадр: отдаёт не больше MaxUploadsPerFrame готовых заявок
+    void Update()
+    {
+        std::vector<AssetHandle> ready;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            size_t count = std::min(completed.size(), MaxUploadsPerFrame);
+            ready.assign(completed.begin(), completed.begin() + count);
+            completed.erase(completed.begin(), completed.begin() + count);
+        }
+
+        for(auto& request : ready)
+        {
+            if(request->IsCancelled())
+                request->state = AssetState::Cancelled;
+            else if(request->GetState() == AssetState::Failed)
+            {
+                std::cerr << "failed to load " << request->path << ": " << request->error << std::endl;
+                if(request->fail)
+                    request->fail();
+            }
+            else
+            {
+                request->finish();
+                request->state = AssetState::Ready;
+            }
+
+            request->finish = nullptr;
+            request->fail = nullptr;
+            pending--;
+        }
+    }
+
+    //Заявки, которые ещё не прошли через Update
+    uint32_t GetPendingCount() const
+    {
+        return pending.load();
+    }
+
+    //Сначала ищется собранный .tex рядом с картинкой; если его нет или он устарел,
+    //картинка декодируется, собирается и сохраняется для следующего запуска
+    static void DecodeTexture(const std::string& path, TextureData& data)
+    {
+        std::string cachePath = TextureCache::GetPath(path);
+        uint64_t sourceHash = MeshCache::HashFile(path);
+
+        if(sourceHash != 0 && TextureCache::Load(cachePath, sourceHash, compressTextures, data.compressed))
+        {
+            data.width = data.compressed.width;
+            data.height = data.compressed.height;
+            return;
+        }
+
+        MappedFile file;
+        if(!Vfs::Open(path, file))
+            throw std::runtime_error("failed to load texture image!");
+
+        int channels;
+        stbi_uc* pixels = stbi_load_from_memory(file.GetData(), static_cast<int>(file.GetSize()), &data.width, &data.height, &channels, STBI_rgb_alpha);
+
+        if(!pixels)
+            throw std::runtime_error("failed to load texture image!");
+
+        CookTexture(pixels, data, TextureCompressor::GuessUsage(path));
+        stbi_image_free(pixels);
+
+        if(!TextureCache::Save(cachePath, sourceHash, compressTextures, data.compressed))
+            std::cerr << "failed to write texture cache " << cachePath << std::endl;
+    }
+
+    //Картинка уже в памяти (png/jpg)
+    static void DecodeTextureFromMemory(const uint8_t* encoded, size_t size, TextureUsage usage, TextureData& data)
+    {
+        int channels;
+        stbi_uc* pixels = stbi_load_from_memory(encoded, static_cast<int>(size), &data.width, &data.height, &channels, STBI_rgb_alpha);
+
+        if(!pixels)
+            throw std::runtime_error("failed to load texture image!");
+
+        CookTexture(pixels, data, usage);
+        stbi_image_free(pixels);
+    }
+
+    //Мип-цепочка в BC, а если формат не поддерживается или сжатие выключено - в RGBA8
+    static void CookTexture(const uint8_t* pixels, TextureData& data, TextureUsage usage, uint32_t maxLevels = 0)
+    {
+        if(!compressTextures || !TextureCompressor::Compress(pixels, data.width, data.height, usage, data.compressed, 0, maxLevels))
+            TextureCompressor::BuildUncompressed(pixels, data.width, data.height, usage, data.compressed, maxLevels);
+    }
+
+    static void DecodeModel(const std::string& path, MeshData& data)
+    {
+        ModelLoader::LoadObj(path, data.model);
+    }
+
+    inline static const size_t MaxUploadsPerFrame = 4;
+
+    //Сжимать текстуры в BC1/BC3/BC4/BC5 при загрузке, если GPU их поддерживает
+    inline static bool compressTextures = true;
+
+private:
+    void complete(const AssetHandle& request)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        completed.push_back(request);
+    }
+
+    std::mutex mutex;
+    std::vector<AssetHandle> completed;
+
+    std::atomic<uint32_t> pending{0};
+
+    //Последним членом: разрушается первым и дожидается рабочих потоков, пока остальное ещё живо
+    ThreadPool pool;
+};
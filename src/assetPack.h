@@ -0,0 +1,258 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "mappedFile.h"
+#include "lz.h"
+
+#include <filesystem>
+
+//Заголовок .pack; за ним записи, затем таблица записей, отсортированная по хэшу пути, и строки путей
+struct AssetPackHeader{
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t padding;
+    uint64_t tocOffset;
+    uint64_t namesOffset;
+};
+
+struct AssetPackEntry{
+    uint64_t hash;
+    uint64_t offset;
+    uint64_t storedSize;
+    uint64_t size;
+    uint32_t compression;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t padding;
+};
+
+enum AssetPackCompression{
+    ASSET_PACK_STORED = 0,
+    ASSET_PACK_LZ = 1
+};
+
+//Много файлов в одном отображённом в память архиве. Несжатые записи читаются прямо из
+//отображения, без копирования; сжатые распаковываются в свой буфер при открытии
+class AssetPack{
+public:
+    inline static const uint32_t Version = 1;
+
+    bool Load(const std::string& path)
+    {
+        auto file = std::make_shared<MappedFile>();
+        if(!file->Open(path) || file->GetSize() < sizeof(AssetPackHeader))
+            return false;
+
+        AssetPackHeader header;
+        memcpy(&header, file->GetData(), sizeof(header));
+
+        if(memcmp(header.magic, "VTPK", 4) != 0 || header.version != Version ||
+           header.tocOffset + (uint64_t)header.entryCount * sizeof(AssetPackEntry) > file->GetSize() || header.namesOffset > file->GetSize())
+            return false;
+
+        //Записи выровнены в файле на 16 байт, таблицу можно читать на месте
+        entries = reinterpret_cast<const AssetPackEntry*>(file->GetData() + header.tocOffset);
+        entryCount = header.entryCount;
+        names = reinterpret_cast<const char*>(file->GetData() + header.namesOffset);
+        namesSize = file->GetSize() - header.namesOffset;
+
+        for(uint32_t i = 0; i < entryCount; i++)
+            if(entries[i].offset + entries[i].storedSize > file->GetSize() || (uint64_t)entries[i].nameOffset + entries[i].nameLength > namesSize)
+                return false;
+
+        this->file = file;
+        return true;
+    }
+
+    const AssetPackEntry* Find(const std::string& path) const
+    {
+        std::string key = NormalizePath(path);
+        uint64_t hash = HashPath(key);
+
+        const AssetPackEntry* end = entries + entryCount;
+        const AssetPackEntry* it = std::lower_bound(entries, end, hash, [](const AssetPackEntry& entry, uint64_t hash){ return entry.hash < hash; });
+
+        //Соседние записи с тем же хэшем различаются по строке пути
+        for(; it != end && it->hash == hash; ++it)
+            if(key.compare(0, std::string::npos, names + it->nameOffset, it->nameLength) == 0)
+                return it;
+
+        return nullptr;
+    }
+
+    //false, если записи нет или сжатые данные битые
+    bool Open(const std::string& path, MappedFile& result) const
+    {
+        const AssetPackEntry* entry = Find(path);
+        if(!entry)
+            return false;
+
+        const uint8_t* stored = file->GetData() + entry->offset;
+
+        if(entry->compression == ASSET_PACK_STORED)
+        {
+            result.OpenView(stored, entry->size, file);
+            return true;
+        }
+
+        auto buffer = std::make_shared<std::vector<uint8_t>>(entry->size);
+        if(!Lz::Decompress(stored, entry->storedSize, buffer->data(), buffer->size()))
+        {
+            std::cerr << "corrupted pack entry " << path << std::endl;
+            return false;
+        }
+
+        result.OpenView(buffer->data(), buffer->size(), buffer);
+        return true;
+    }
+
+    uint32_t GetEntryCount() const { return entryCount; }
+
+    //Пути в паке относительные, с прямыми слэшами и без "./"
+    static std::string NormalizePath(const std::string& path)
+    {
+        std::string result = path;
+        std::replace(result.begin(), result.end(), '\\', '/');
+
+        while(result.compare(0, 2, "./") == 0)
+            result.erase(0, 2);
+
+        return result;
+    }
+
+    //FNV-1a
+    static uint64_t HashPath(const std::string& path)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for(char c : path)
+            hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+
+        return hash;
+    }
+
+    //Собирает пак из файлов каталога root (пути в паке - относительно root). Запись сжимается,
+    //только если это экономит хотя бы MinSaving её размера, иначе лежит как есть.
+    //directories - только эти подкаталоги root; пустой список - весь root. Сам пак в себя не попадает
+    static bool Build(const std::string& packPath, const std::string& root, bool compress = true, const std::vector<std::string>& directories = {})
+    {
+        struct Source{
+            std::string name;
+            std::string path;
+        };
+
+        std::vector<Source> sources;
+
+        std::error_code error;
+        std::filesystem::path output = std::filesystem::absolute(packPath, error).lexically_normal();
+
+        for(auto it = std::filesystem::recursive_directory_iterator(root, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+        {
+            if(!it->is_regular_file())
+                continue;
+
+            std::string name = NormalizePath(std::filesystem::relative(it->path(), root).generic_string());
+            if(name.size() >= 4 && name.compare(name.size() - 4, 4, ".tmp") == 0)
+                continue;
+
+            if(std::filesystem::absolute(it->path(), error).lexically_normal() == output)
+                continue;
+
+            if(!directories.empty() && std::find(directories.begin(), directories.end(), name.substr(0, name.find('/'))) == directories.end())
+                continue;
+
+            sources.push_back({name, it->path().string()});
+        }
+
+        if(error)
+            return false;
+
+        std::vector<AssetPackEntry> toc;
+        std::string names;
+        std::vector<uint8_t> data(align(sizeof(AssetPackHeader)), 0);
+
+        for(auto& source : sources)
+        {
+            MappedFile file;
+            const uint8_t* bytes = nullptr;
+            size_t size = 0;
+
+            if(file.Open(source.path))
+            {
+                bytes = file.GetData();
+                size = file.GetSize();
+            }
+
+            AssetPackEntry entry{};
+            entry.hash = HashPath(source.name);
+            entry.offset = data.size();
+            entry.size = size;
+            entry.storedSize = size;
+            entry.compression = ASSET_PACK_STORED;
+            entry.nameOffset = static_cast<uint32_t>(names.size());
+            entry.nameLength = static_cast<uint32_t>(source.name.size());
+
+            std::vector<uint8_t> packed;
+            if(compress && size > 0)
+            {
+                packed = Lz::Compress(bytes, size);
+                if(packed.size() + size * MinSaving <= size)
+                {
+                    entry.compression = ASSET_PACK_LZ;
+                    entry.storedSize = packed.size();
+                    bytes = packed.data();
+                }
+            }
+
+            data.insert(data.end(), bytes, bytes + entry.storedSize);
+            data.resize(align(data.size()), 0);
+
+            names += source.name;
+            toc.push_back(entry);
+        }
+
+        std::sort(toc.begin(), toc.end(), [](const AssetPackEntry& a, const AssetPackEntry& b){ return a.hash < b.hash; });
+
+        AssetPackHeader header{};
+        memcpy(header.magic, "VTPK", 4);
+        header.version = Version;
+        header.entryCount = static_cast<uint32_t>(toc.size());
+        header.tocOffset = data.size();
+        header.namesOffset = header.tocOffset + toc.size() * sizeof(AssetPackEntry);
+
+        data.insert(data.end(), reinterpret_cast<const uint8_t*>(toc.data()), reinterpret_cast<const uint8_t*>(toc.data() + toc.size()));
+        data.insert(data.end(), names.begin(), names.end());
+        memcpy(data.data(), &header, sizeof(header));
+
+        //Пишем во временный файл и подменяем, чтобы оборванная запись не оставила битый пак
+        std::string temp = packPath + ".tmp";
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if(!file)
+                return false;
+
+            file.write(reinterpret_cast<const char*>(data.data()), data.size());
+            if(!file)
+                return false;
+        }
+
+        std::remove(packPath.c_str());
+        return std::rename(temp.c_str(), packPath.c_str()) == 0;
+    }
+
+    inline static const double MinSaving = 0.125;
+
+private:
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 15) & ~uint64_t(15);
+    }
+
+    std::shared_ptr<MappedFile> file;
+
+    const AssetPackEntry* entries = nullptr;
+    uint32_t entryCount = 0;
+    const char* names = nullptr;
+    size_t namesSize = 0;
+};
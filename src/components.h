@@ -0,0 +1,33 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "model.h"
+#include "pipeline.h"
+#include "textureStreamer.h"
+
+struct TransformComponent{
+    uint32_t transform;
+};
+
+struct RenderComponent{
+    Model* model;
+    Pipeline* pipeline;
+    bool applyLight;
+    int layer;
+    bool visible;
+    uint32_t lod;
+    //Uniform-буфер пайплайна общий и его пишет владелец (чанки ландшафта), общий проход его пропускает
+    bool sharedUniforms = false;
+};
+
+//Сфера в локальных координатах меша
+struct BoundsComponent{
+    glm::vec3 center;
+    float radius;
+};
+
+//Текстура, которой отсечение сообщает нужный мип-уровень
+struct TextureStreamComponent{
+    StreamedTexture* texture;
+};
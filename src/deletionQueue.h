@@ -0,0 +1,69 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "resource.h"
+
+#include <functional>
+#include <memory>
+
+//Отложенное удаление GPU-ресурсов: удаление выполняется, когда пройдут все кадры,
+//которые могли на ресурс ссылаться. Только главный поток
+class DeletionQueue{
+public:
+    static void Push(std::function<void()> destroy)
+    {
+        entries.push_back({frame, std::move(destroy)});
+    }
+
+    //shared_ptr, последний владелец которого не удаляет объект сразу, а ставит его в очередь
+    template<typename T>
+    static std::shared_ptr<T> MakeShared(T* object)
+    {
+        return std::shared_ptr<T>(object, [](T* p){ Push([p]{ delete p; }); });
+    }
+
+    //Раз в кадр
+    static void Update()
+    {
+        frame++;
+
+        size_t done = 0;
+        while(done < entries.size() && frame - entries[done].frame > Resource::countFrames)
+            done++;
+
+        //Удаление может само поставить что-то в очередь, поэтому сначала вынимаем
+        std::vector<Entry> ready(std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.begin() + done));
+        entries.erase(entries.begin(), entries.begin() + done);
+
+        for(auto& entry : ready)
+            entry.destroy();
+    }
+
+    //При выходе, после vkDeviceWaitIdle
+    static void Flush()
+    {
+        while(!entries.empty())
+        {
+            std::vector<Entry> ready = std::move(entries);
+            entries.clear();
+
+            for(auto& entry : ready)
+                entry.destroy();
+        }
+    }
+
+    static size_t GetCount()
+    {
+        return entries.size();
+    }
+
+private:
+    struct Entry{
+        uint64_t frame;
+        std::function<void()> destroy;
+    };
+
+    inline static std::vector<Entry> entries;
+    inline static uint64_t frame = 0;
+};
@@ -58,8 +58,14 @@ public:
         float queuePriority = 1.0f;
         queueCreateInfo.pQueuePriorities = &queuePriority; 
 
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+        multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+
         VkPhysicalDeviceFeatures deviceFeatures{};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
 
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -217,6 +223,8 @@ public:
 
     uint32_t g_QueueFamily;
 
+    bool multiDrawIndirect = false;
+
     WindowManager* window;
 
 };
\ No newline at end of file
@@ -57,7 +57,6 @@ public:
         go->SetPosition(sunPos);
         go->SetRotation(glm::vec3(0,-resultAngle + 90,0) * 10.0f);      
         Resource::sunDir = glm::vec3(cos(resultAngle), -0.5f, sin(resultAngle));
-        go->Update(deltaTime);
     }
 
     void SetTarget(glm::vec3 pos)
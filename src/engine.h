@@ -23,6 +23,13 @@ public:
         }
                 
         delete game;
+        delete assetCache;
+
+        //Всё, что ждало конца кадров, удаляется до пула геометрии и устройства
+        DeletionQueue::Flush();
+        SamplerCache::Destroy();
+
+        delete geometryPool;
         delete graphics;
         delete swapchain;
         //ImGui_ImplVulkanH_DestroyWindow(window->instance, device->device, &Resource::g_MainWindowData, window->g_Allocator);
@@ -44,11 +51,24 @@ public:
 
         Tools::device = device;
 
+        SamplerCache::Init(device);
+
+        //Собранные ассеты, если пак лежит рядом; иначе всё читается из обычных файлов
+        Vfs::Mount("assets.pack");
+
         swapchain = new SwapChain(window, device);
         swapchain->Init();
 
         graphics = new Graphics(window, device, swapchain);
 
+        geometryPool = new GeometryPool(device);
+        Model::pool = geometryPool;
+
+        TextureCompressor::Init(device->physicalDevice);
+
+        assetCache = new AssetCache(device);
+        Entity::assets = assetCache;
+
         game = new Game(device, graphics);
         game->Init();
         
@@ -131,6 +151,7 @@ public:
         init_info.MinImageCount = 2;
         init_info.ImageCount = 3;
         init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+        init_info.PipelineCache = Renderer::pipelineCache;
 
         ImGui_ImplVulkan_Init(&init_info, graphics->renderer->renderPass);
 
@@ -151,6 +172,11 @@ private:
     Device* device;
     SwapChain* swapchain;
     Graphics* graphics;
+    GeometryPool* geometryPool;
+    AssetCache* assetCache;
+
+    //Доля свободного места в пуле геометрии, не влезающая одним куском, после которой пул сжимается
+    inline static const float CompactThreshold = 0.5f;
 
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
@@ -161,6 +187,12 @@ private:
     
     void Update()
     {        
+        DeletionQueue::Update();
+
+        //Освобождённые участки уже не читает ни один кадр, можно переупаковать пул
+        if(geometryPool->GetFragmentation() > CompactThreshold)
+            geometryPool->Compact();
+
         static auto startTime = std::chrono::high_resolution_clock::now();
 
         auto currentTime = std::chrono::high_resolution_clock::now();
@@ -203,6 +235,21 @@ private:
             ImGui::Begin("Hello, world!");                          // Create a window called "Hello, world!" and append into it.
 
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+            ImGui::Text("Triangles %u (%u without LOD)", Systems::trianglesDrawn, Systems::trianglesFull);
+            if(!game->meshletRenderer->gpuCulling)
+                ImGui::Text("Clusters visible %u", game->meshletRenderer->clustersVisible);
+            if(game->assetLoader->GetPendingCount() > 0)
+                ImGui::Text("Assets loading %u", game->assetLoader->GetPendingCount());
+            ImGui::Text("Cache: %zu textures, %zu models, %u hits, %u misses, %zu deferred", assetCache->GetTextureCount(), assetCache->GetModelCount(),
+                        assetCache->hits, assetCache->misses, DeletionQueue::GetCount());
+            ImGui::Text("Samplers %zu, anisotropy %.0fx", SamplerCache::GetCount(), SamplerCache::anisotropy);
+            ImGui::Text("Streamed textures %zu, %.1f / %.1f MB", game->textureStreamer->GetTextureCount(),
+                        game->textureStreamer->GetResidentBytes() / 1048576.0, game->textureStreamer->budget / 1048576.0);
+            ImGui::Text("Terrain chunks %zu (%u meshed, %u building), %u chunks/s on %u threads", game->terrain->GetChunkCount(), game->terrain->GetMeshedCount(),
+                        game->terrain->GetInFlight(), game->terrain->GetBuildRate(), game->terrain->GetThreadCount());
+            if(game->hotReload->reloads > 0)
+                ImGui::Text("Hot reload %u (%u failed), last %.1f ms, max %.1f ms", game->hotReload->reloads, game->hotReload->failures,
+                            game->hotReload->lastLatency, game->hotReload->maxLatency);
             
             ImGui::InputFloat3("Sun Dir", v);
             ImGui::End();
@@ -277,6 +324,8 @@ private:
         beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
         vkBeginCommandBuffer(graphics->commandBuffers[currentFrame], &beginInfo);
+
+        game->PrepareDraw(graphics->commandBuffers[currentFrame]);
             
         std::array<VkClearValue, 2> clearValues{};
         clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
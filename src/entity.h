@@ -7,6 +7,8 @@
 #include "tools.h"
 
 #include "model.h"
+#include "assetCache.h"
+#include "textureStreamer.h"
 #include "pipeline.h"
 
 class Entity{
@@ -15,27 +17,28 @@ public:
         this->device = device;
         this->camera = camera;
 
-        m_model = new Model(device);
+        m_model = DeletionQueue::MakeShared(new Model(device));
 
         pipeline = new Pipeline(this->device);
         
     }
-    ~Entity(){      
+    virtual ~Entity(){      
         
-        delete m_model;
-
-        if(pipeline->textureImageView != VK_NULL_HANDLE)
-        {
-            vkDestroyImage(device->device, textureImage, nullptr);
-            vkFreeMemory(device->device, textureImageMemory, nullptr);
-        }    
+        if(textureRequest)
+            textureRequest->Cancel();
+        if(modelRequest)
+            modelRequest->Cancel();
+        if(streamedTexture)
+            streamedTexture->Unsubscribe(this);
 
         delete pipeline;       
 
     }
     virtual void Init()
     {
-        m_model->Init();
+        //Общая модель из AssetCache уже загружена; свою грузим, если геометрия менялась
+        if(!m_model->uploaded || m_model->lods.empty())
+            m_model->Init();
         pipeline->Init();
     }
 
@@ -46,195 +49,126 @@ public:
 
     void LoadTexture(std::string filepath)
     {
-        createTextureImage(filepath);
-        createTextureImageView();
-        createTextureSampler();
-        
+        SetTexture(assets->GetTexture(filepath));
     }
 
-    void LoadModel(std::string filepath)
+    //Картинка уже в памяти (png/jpg), например встроенная в .glb; key - имя для кэша
+    void LoadTexture(const std::string& key, const uint8_t* data, size_t size)
     {
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string warn, err;
-
-        m_model->vertices.clear();
-        m_model->indices.clear();
-
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str())) {
-            throw std::runtime_error(warn + err);
-        }
-
-        for (const auto& shape : shapes) {
-            for (const auto& index : shape.mesh.indices) {
-                Vertex vertex{};
-
-                vertex.pos = {
-                    attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]
-                };
-
-                vertex.normal = {
-                    attrib.normals[index.normal_index * 3 + 0],
-                    attrib.normals[index.normal_index * 3 + 1],
-                    attrib.normals[index.normal_index * 3 + 2]
-                };
-
-                vertex.texCoord = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-                };
-
-                vertex.color = {0.5f, 0.5f, 0.5f};
-
-                m_model->vertices.push_back(vertex);
-                m_model->indices.push_back(m_model->indices.size());
-            }
-        }
+        SetTexture(assets->GetTexture(key, data, size));
     }
 
-    void createTextureImage(std::string filepath) {
-        int texWidth, texHeight, texChannels;
-        stbi_uc* pixels = stbi_load(filepath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-        if (!pixels) {
-            throw std::runtime_error("failed to load texture image!");
-        }
+    //Пайплайн только ссылается на вид и сэмплер, владеет ими Texture
+    void SetTexture(std::shared_ptr<Texture> texture)
+    {
+        this->texture = texture;
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        Tools::createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+        pipeline->textureImageView = texture->view;
+        pipeline->textureSampler = texture->sampler;
+        pipeline->UpdateTextureDescriptors();
+    }
 
-        void* data;
-        vkMapMemory(device->device, stagingBufferMemory, 0, imageSize, 0, &data);
-            memcpy(data, pixels, static_cast<size_t>(imageSize));
-        vkUnmapMemory(device->device, stagingBufferMemory);
+    void LoadModel(std::string filepath)
+    {
+        m_model = assets->GetModel(filepath, m_model->layout);
+        OnGeometryChanged();
+    }
 
-        stbi_image_free(pixels);
+    //Картинка декодируется в фоне, до тех пор объект рисуется с серой клеткой 2x2
+    void LoadTextureAsync(AssetLoader& loader, std::string filepath, JobPriority priority = JobPriority::Normal)
+    {
+        SetTexture(assets->GetPlaceholderTexture());
 
-        Tools::createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+        textureRequest = assets->LoadTextureAsync(loader, filepath, priority, [this](std::shared_ptr<Texture> texture){
+            SetTexture(texture);
+        });
+    }
 
-        transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        
-        Tools::copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+    //Детальные мип-уровни подгружаются по мере того, как объект крупнеет на экране;
+    //звать до Init, чтобы GameObject завёл TextureStreamComponent
+    void LoadTextureStreamed(TextureStreamer& streamer, AssetLoader& loader, std::string filepath, JobPriority priority = JobPriority::Normal)
+    {
+        if(streamedTexture)
+            streamedTexture->Unsubscribe(this);
 
-        vkDestroyBuffer(device->device, stagingBuffer, nullptr);
-        vkFreeMemory(device->device, stagingBufferMemory, nullptr);
+        streamedTexture = streamer.Load(loader, filepath, priority);
+        streamedTexture->Subscribe(this, [this](std::shared_ptr<Texture> texture){
+            SetTexture(texture);
+        });
 
+        SetTexture(streamedTexture->GetTexture() ? streamedTexture->GetTexture() : assets->GetPlaceholderTexture());
     }
 
-    void createTextureImageView() {
-        pipeline->textureImageView = Tools::createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);  
+    //Модель разбирается в фоне, до тех пор на её месте куб
+    void LoadModelAsync(AssetLoader& loader, std::string filepath, JobPriority priority = JobPriority::Normal)
+    {
+        PrimitiveObject placeholder = Tools::GetPrimitives(PRIMITIVE_TYPE_CUBE);
+
+        DetachModel();
+        m_model->vertices = placeholder.vertices;
+        m_model->indices = placeholder.indices;
+        m_model->lods.clear();
+        m_model->meshlets.clear();
+        m_model->ResetCache();
+
+        modelRequest = assets->LoadModelAsync(loader, filepath, m_model->layout, priority, [this](std::shared_ptr<Model> model){
+            m_model = model;
+            OnGeometryChanged();
+        });
     }
 
-    void createTextureSampler() {
-        VkSamplerCreateInfo samplerInfo{};
-        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-        samplerInfo.magFilter = VK_FILTER_LINEAR;
-        samplerInfo.minFilter = VK_FILTER_LINEAR;
-        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-
-        samplerInfo.anisotropyEnable = VK_FALSE;
-        samplerInfo.maxAnisotropy = 1.0f;
-        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-        samplerInfo.unnormalizedCoordinates = VK_FALSE;
-        samplerInfo.compareEnable = VK_FALSE;
-        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-        samplerInfo.mipLodBias = 0.0f;
-        samplerInfo.minLod = 0.0f;
-        samplerInfo.maxLod = 0.0f;
-
-        if (vkCreateSampler(device->device, &samplerInfo, nullptr, &pipeline->textureSampler) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create texture sampler!");
-        }
+    //Перед правкой геометрии или раскладки общая модель заменяется своей копией
+    void DetachModel()
+    {
+        if(m_model.use_count() <= 1)
+            return;
+
+        std::shared_ptr<Model> own = DeletionQueue::MakeShared(new Model(device));
+        own->layout = m_model->layout;
+        own->CopyGeometry(*m_model);
+
+        m_model = own;
+        OnGeometryChanged();
     }
 
-    void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-        VkCommandBuffer commandBuffer = Tools::beginSingleTimeCommands();
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = oldLayout;
-        barrier.newLayout = newLayout;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = image;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.srcAccessMask = 0; // TODO
-        barrier.dstAccessMask = 0; // TODO
-
-        VkPipelineStageFlags sourceStage;
-        VkPipelineStageFlags destinationStage;
-
-        if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        } else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        } else {
-            throw std::invalid_argument("unsupported layout transition!");
-        }
-
-        vkCmdPipelineBarrier(
-            commandBuffer,
-            sourceStage, destinationStage,
-            0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier
-        );
-
-        Tools::endSingleTimeCommands(commandBuffer);
+    //Вызывается после подмены модели или её геометрии
+    virtual void OnGeometryChanged()
+    {
     }
 
     void Draw(VkCommandBuffer commandBuffer, int i)
     {
         
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->graphicsPipeline);
-        
-        VkBuffer vertexBuffers[] = {m_model->vertexBuffer};
-        VkDeviceSize offsets[] = {0};
 
-        if(m_model->vertices.size() > 0)
-            vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-            
-        if(m_model->indices.size() > 0)
-            vkCmdBindIndexBuffer(commandBuffer, m_model->indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+        if(!m_model->uploaded)
+            return;
+
+        const GeometryAllocation& geometry = Model::pool->Get(m_model->geometry);
+
+        Model::pool->Bind(commandBuffer, geometry);
 
         vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipelineLayout, 0, 1, &pipeline->descriptorSets[i], 0, nullptr);
-        //vkCmdDraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
-        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m_model->indices.size()), 1, 0, 0, 0);
+        vkCmdDrawIndexed(commandBuffer, m_model->lods[0].indexCount, 1, geometry.firstIndex, geometry.vertexOffset, 0);
     }
 
     Device* device;
     Camera* camera;
 
-    Model* m_model;
+    std::shared_ptr<Model> m_model;
 
     Pipeline* pipeline;
     
-    VkImage textureImage = VK_NULL_HANDLE;
-    VkDeviceMemory textureImageMemory;
+    std::shared_ptr<Texture> texture;
+    std::shared_ptr<StreamedTexture> streamedTexture;
+
+    AssetHandle textureRequest;
+    AssetHandle modelRequest;
 
     float direction, speed;
 
     glm::vec3 position;
 
+    inline static AssetCache* assets;
+
 };
\ No newline at end of file
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include <filesystem>
+#include <unordered_map>
+
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <unistd.h>
+    #include <fcntl.h>
+#endif
+
+struct FileChange{
+    std::string path;
+    //Когда изменение замечено впервые, от этого считается задержка перезагрузки
+    std::chrono::steady_clock::time_point detected;
+};
+
+//Следит за файлами с нужными расширениями в каталогах. На Linux - inotify, иначе (или если
+//inotify недоступен) - опрос времени изменения раз в PollInterval. Редакторы пишут файл
+//в несколько приёмов, поэтому изменение отдаётся, только когда файл DebounceTime не менялся
+class FileWatcher{
+public:
+    FileWatcher()
+    {
+#ifdef __linux__
+        inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    }
+    ~FileWatcher()
+    {
+#ifdef __linux__
+        if(inotify >= 0)
+            close(inotify);
+#endif
+    }
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    //extensions вида ".spv"; без подкаталогов
+    void WatchDirectory(const std::string& directory, std::vector<std::string> extensions)
+    {
+        std::error_code error;
+        if(!std::filesystem::is_directory(directory, error))
+            return;
+
+        Directory watched;
+        watched.path = directory;
+        watched.extensions = extensions;
+
+#ifdef __linux__
+        if(inotify >= 0)
+            watched.descriptor = inotify_add_watch(inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+#endif
+
+        //Без inotify запоминаем текущие времена, чтобы первый опрос не счёл всё изменённым
+        if(watched.descriptor < 0)
+            for(auto& entry : std::filesystem::directory_iterator(directory, error))
+                if(entry.is_regular_file(error) && matches(watched, entry.path().filename().string()))
+                    watched.times[entry.path().generic_string()] = entry.last_write_time(error);
+
+        directories.push_back(std::move(watched));
+    }
+
+    //Главный поток, раз в кадр; не блокирует
+    std::vector<FileChange> Poll()
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        readEvents(now);
+
+        if(now - lastPoll >= PollInterval)
+        {
+            lastPoll = now;
+            pollTimes(now);
+        }
+
+        std::vector<FileChange> ready;
+        for(auto it = pending.begin(); it != pending.end();)
+        {
+            if(now - it->second.last >= DebounceTime)
+            {
+                ready.push_back({it->first, it->second.first});
+                it = pending.erase(it);
+            }
+            else
+                ++it;
+        }
+
+        return ready;
+    }
+
+    bool UsesInotify() const
+    {
+        for(auto& directory : directories)
+            if(directory.descriptor < 0)
+                return false;
+
+        return !directories.empty();
+    }
+
+    inline static const std::chrono::milliseconds PollInterval{500};
+    inline static const std::chrono::milliseconds DebounceTime{100};
+
+private:
+    struct Directory{
+        std::string path;
+        std::vector<std::string> extensions;
+        int descriptor = -1;
+        std::unordered_map<std::string, std::filesystem::file_time_type> times;
+    };
+
+    struct Pending{
+        std::chrono::steady_clock::time_point first;
+        std::chrono::steady_clock::time_point last;
+    };
+
+    static bool matches(const Directory& directory, const std::string& name)
+    {
+        for(auto& extension : directory.extensions)
+            if(name.size() >= extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0)
+                return true;
+
+        return false;
+    }
+
+    void touch(const std::string& path, std::chrono::steady_clock::time_point now)
+    {
+        auto it = pending.find(path);
+        if(it == pending.end())
+            pending[path] = {now, now};
+        else
+            it->second.last = now;
+    }
+
+    void readEvents(std::chrono::steady_clock::time_point now)
+    {
+#ifdef __linux__
+        if(inotify < 0)
+            return;
+
+        alignas(inotify_event) char buffer[4096];
+
+        while(true)
+        {
+            ssize_t length = read(inotify, buffer, sizeof(buffer));
+            if(length <= 0)
+                break;
+
+            for(char* p = buffer; p < buffer + length;)
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + event->len;
+
+                if(event->len == 0)
+                    continue;
+
+                for(auto& directory : directories)
+                    if(directory.descriptor == event->wd && matches(directory, event->name))
+                        touch(directory.path + "/" + event->name, now);
+            }
+        }
+#endif
+    }
+
+    void pollTimes(std::chrono::steady_clock::time_point now)
+    {
+        std::error_code error;
+
+        for(auto& directory : directories)
+        {
+            if(directory.descriptor >= 0)
+                continue;
+
+            for(auto& entry : std::filesystem::directory_iterator(directory.path, error))
+            {
+                if(!entry.is_regular_file(error) || !matches(directory, entry.path().filename().string()))
+                    continue;
+
+                std::string path = directory.path + "/" + entry.path().filename().string();
+                auto time = entry.last_write_time(error);
+
+                auto it = directory.times.find(path);
+                if(it == directory.times.end() || it->second != time)
+                {
+                    directory.times[path] = time;
+                    touch(path, now);
+                }
+            }
+        }
+    }
+
+    std::vector<Directory> directories;
+    std::unordered_map<std::string, Pending> pending;
+
+    std::chrono::steady_clock::time_point lastPoll;
+
+    int inotify = -1;
+};
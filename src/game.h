@@ -4,11 +4,17 @@
 
 #include "skyBox.h"
 #include "gameObject.h"
+#include "gltfScene.h"
 
 #include "dirLight.h"
 
+#include "registry.h"
+#include "systems.h"
+
 #include "device.h"
 #include "graphics.h"
+#include "hotReload.h"
+#include "terrain.h"
 
 class Game{
 public:
@@ -19,8 +25,16 @@ public:
     }
     ~Game()
     {
+        //Первым: рабочие потоки останавливаются до удаления объектов, ждущих их результаты
+        delete assetLoader;
+        delete hotReload;
+        delete terrain;
+        delete textureStreamer;
+
+        delete meshletRenderer;
 
         delete gameObject;
+        delete scene;
         delete skyBox;
         delete dirLight;
         delete camera;
@@ -29,48 +43,97 @@ public:
     void Init(){
         
         camera = new Camera(Resource::swapChainExtent.width, Resource::swapChainExtent.height);
-        
-        PrimitiveObject Terrain;
 
+        GameObject::registry = &registry;
+
+        meshletRenderer = new MeshletRenderer(device);
+
+        assetLoader = new AssetLoader();
+        textureStreamer = new TextureStreamer(device);
+        
         gameObject = new GameObject(device, camera);
         gameObject->SetShadersName("shaders/vert.spv","shaders/frag.spv");    
+        //До загрузки модели: кэш ассетов хранит её уже в сжатой раскладке
+        gameObject->SetVertexLayout(VertexLayout::Compact());
         gameObject->SetSize(glm::vec3(2.0f,2.0f,2.0f));      
         gameObject->SetPosition({0,0,6});  
-        gameObject->LoadTexture("textures/text2.png");
-        gameObject->LoadModel("models/model.obj");
+        gameObject->LoadTextureStreamed(*textureStreamer, *assetLoader, "textures/text2.png");
+        gameObject->LoadModelAsync(*assetLoader, "models/model.obj", JobPriority::High);
         gameObject->SetFrontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE);
         gameObject->applyLight = true;
         gameObject->Init();
 
+        //Сцена от художников, если она лежит рядом
+        if(Vfs::Exists("models/scene.glb"))
+        {
+            scene = new GltfScene(device, camera);
+            scene->Load("models/scene.glb");
+            scene->SetPosition({0,0,-6});
+            scene->Init();
+        }
+
         skyBox = new SkyBox(device, camera, {"shaders/skyVert.spv","shaders/skyFrag.spv"});
 
         dirLight = new DirLight(device, camera, {"shaders/sunV.spv","shaders/sunF.spv"});
         dirLight->Init();     
+
+        terrain = new Terrain(device, camera, &registry);
         
         graphics->SetGameObject(gameObject);
+        if(scene)
+            for(auto object : scene->objects)
+                graphics->SetGameObject(object);
         graphics->SetGameObject(skyBox->go);
         graphics->SetGameObject(dirLight->go);
+        graphics->SetGameObject(terrain->go);
+
+        hotReload = new HotReload(graphics, meshletRenderer, assetLoader, textureStreamer, &registry);
     }
 
     void Update(float time){
 
+        //Правки файлов ставят перечитывание в очередь загрузчика, шейдеры пересобираются сразу
+        hotReload->Update();
+
+        //Готовые ассеты грузятся в GPU до отсечения и записи команд
+        assetLoader->Update();
+
         camera->Update(time);
+
+        //Новые чанки вокруг камеры уходят в пул, дальние выгружаются
+        terrain->Update();
         gameObject->Rotating(glm::vec3(0,0,1) * time);
-        gameObject->Update(time);
 
         dirLight->SetTarget(camera->GetPosition());  
         dirLight->Update(time);
 
         skyBox->Update(time);
+
+        Transforms::Update();
+
+        Systems::Cull(registry, camera);
+        Systems::UpdateUniforms(registry, camera);
+        terrain->UpdateUniforms();
+
+        //Уровни, запрошенные отсечением этого кадра
+        textureStreamer->Update();
+    }
+
+    //Вызывается до начала render pass: здесь работает компьютный проход отсечения кластеров
+    void PrepareDraw(VkCommandBuffer cmd)
+    {
+        textureStreamer->Record(cmd);
+
+        Systems::BuildDrawPackets(registry, camera, meshletRenderer, drawPackets);
+
+        meshletRenderer->Dispatch(cmd);
     }
 
     void Draw(VkCommandBuffer cmd, int indx)
     {        
-        gameObject->Draw(cmd, indx);
-        
-        skyBox->go->Draw(cmd, indx);        
-        
-        dirLight->go->Draw(cmd, indx);
+        Model::pool->ResetBindings();
+
+        Systems::Draw(cmd, indx, meshletRenderer, drawPackets);
 
     }
 
@@ -82,10 +145,22 @@ public:
 
     GameObject* gameObject;
 
+    GltfScene* scene = nullptr;
+
     DirLight* dirLight;
 
     Device* device; 
 
-    std::vector<std::vector<std::vector<GameObject*>>> chunks;
+    Registry registry;
+
+    std::vector<DrawPacket> drawPackets;
+
+    MeshletRenderer* meshletRenderer;
+
+    AssetLoader* assetLoader;
+    TextureStreamer* textureStreamer;
+    HotReload* hotReload = nullptr;
+
+    Terrain* terrain = nullptr;
 
 };
\ No newline at end of file
@@ -6,66 +6,77 @@
 #include "device.h"
 #include "resource.h"
 #include "camera.h"
+#include "transform.h"
+#include "registry.h"
+#include "components.h"
 
 class GameObject : public Entity{
 public:
-    GameObject(Device* device, Camera* camera) : Entity(device, camera), size(1.0f)
+    GameObject(Device* device, Camera* camera) : Entity(device, camera)
     {
-        model = glm::mat4(1.0f);
+        transform = Transforms::Create();
     }
     ~GameObject(){
-        
+        if(entity != NullEntity)
+            registry->Destroy(entity);
+
+        Transforms::Destroy(transform);
     }
     void Init(){
         Entity::Init();
 
-    }
+        if(entity == NullEntity)
+            entity = registry->Create();
 
-    void Update(float deltaTime)
-    {
-        AppyTransforms(deltaTime);
-        updateUniformBuffer(deltaTime);
+        registry->Add<TransformComponent>(entity, {transform});
+        registry->Add<RenderComponent>(entity, {m_model.get(), pipeline, applyLight, layer, true, 0});
+        registry->Add<BoundsComponent>(entity, {m_model->boundsCenter, m_model->boundsRadius});
+
+        if(streamedTexture)
+            registry->Add<TextureStreamComponent>(entity, {streamedTexture.get()});
     }
     
+    void OnGeometryChanged() override
+    {
+        if(entity == NullEntity)
+            return;
+
+        if(registry->Has<RenderComponent>(entity))
+            registry->Get<RenderComponent>(entity).model = m_model.get();
+        if(registry->Has<BoundsComponent>(entity))
+            registry->Get<BoundsComponent>(entity) = {m_model->boundsCenter, m_model->boundsRadius};
+    }
+
     void setVertex(std::vector<Vertex> vertices)
     {
+        DetachModel();
         this->m_model->vertices = vertices;
+        this->m_model->lods.clear();
+        this->m_model->ResetCache();
     }
     
-    void setIndices(std::vector<uint16_t> indices)
+    void setIndices(std::vector<uint32_t> indices)
     {
+        DetachModel();
         this->m_model->indices = indices;
+        this->m_model->lods.clear();
+        this->m_model->ResetCache();
     }
 
     void SetPosition(glm::vec3 position)
     {
         position /= 10;
-        this->position = position;
-    }
-
-    
-    void AppyTransforms(float deltaTime)
-    {
-
-        glm::mat4 scaleMatrix = glm::scale(glm::mat4(1.0f), size);
-        glm::mat4 rotationMatrix;
-        rotationMatrix = glm::rotate(rotationMatrix, rotate.x, glm::vec3(1,0,0));
-        rotationMatrix = glm::rotate(rotationMatrix, rotate.y, glm::vec3(0,1,0));
-        rotationMatrix = glm::rotate(rotationMatrix, rotate.z, glm::vec3(0,0,1));
-        glm::mat4 translateMatrix = glm::translate(glm::mat4(1.0f), position);
-
-        model = translateMatrix * rotationMatrix * scaleMatrix * deltaTime;
-
+        Transforms::SetPosition(transform, position);
     }
 
     glm::vec3 GetPosition()
     {
-        return position * 10.0f;
+        return Transforms::GetPosition(transform) * 10.0f;
     }
 
     void SetSize(glm::vec3 size)
     {
-        this->size = size;
+        Transforms::SetScale(transform, size);
     }
 
     void SetShadersName(std::string vertFile,std::string fragFile)
@@ -74,53 +85,81 @@ public:
         this->fragFile = fragFile;
     }
 
+    //Сжатая раскладка вершин. Если устройство не читает её форматы или шейдер с декодом
+    //ещё не собран, объект остаётся на полной раскладке и своих шейдерах
+    bool SetVertexLayout(const VertexLayout& layout, std::string decodeVertFile = "shaders/compactVert.spv")
+    {
+        if(!layout.IsSupported(device->physicalDevice))
+            return false;
+
+        if(layout.NeedsDecode())
+        {
+            if(!Vfs::Exists(decodeVertFile))
+                return false;
+
+            vertFile = decodeVertFile;
+        }
+
+        DetachModel();
+        m_model->layout = layout;
+        pipeline->vertexLayout = layout;
+
+        return true;
+    }
+
     void SetRotation(glm::vec3 rotation)
     {   
         rotation /=10.0f;
-        this->rotate = rotation;
+        Transforms::SetRotation(transform, EulerToQuat(rotation));
 
     }
 
     void Rotating(glm::vec3 rotation)
     {   
         rotation /=10.0f;
-        this->rotate += rotation;
+        Transforms::SetRotation(transform, glm::normalize(Transforms::GetRotation(transform) * EulerToQuat(rotation)));
 
     }
 
     glm::vec3 GetRotate()
     {
-        return rotate * 10.0f;
+        return QuatToEuler(Transforms::GetRotation(transform)) * 10.0f;
     }
 
-    std::string vertFile, fragFile;   
-    
-    bool applyLight;
+    void SetParent(GameObject* parent)
+    {
+        Transforms::SetParent(transform, parent ? parent->transform : Transforms::NoParent);
+    }
 
-private :
-    void updateUniformBuffer(float deltaTime) {
-        static auto startTime = std::chrono::high_resolution_clock::now();
+    //Тот же порядок осей, что и прежние три вызова glm::rotate: X, затем Y, затем Z
+    static glm::quat EulerToQuat(glm::vec3 rotation)
+    {
+        return glm::angleAxis(rotation.x, glm::vec3(1,0,0)) * glm::angleAxis(rotation.y, glm::vec3(0,1,0)) * glm::angleAxis(rotation.z, glm::vec3(0,0,1));
+    }
 
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-        
-        UniformBufferObject ubo{};
-        ubo.model = model;
-        ubo.view = camera->view;
-        ubo.proj = camera->proj;
+    //Обратное к EulerToQuat: разложение матрицы Rx * Ry * Rz. При y = ±90° X и Z вращают
+    //вокруг одной оси, тогда весь поворот относится к X
+    static glm::vec3 QuatToEuler(const glm::quat& rotation)
+    {
+        glm::mat3 m = glm::mat3_cast(rotation);
 
-        ubo.sunDir = applyLight ? Resource::sunDir : glm::vec3(1.0f, -3.0f, -1.0f);
+        float sinY = std::clamp(m[2][0], -1.0f, 1.0f);
+        float y = std::asin(sinY);
 
-        void* data;
-        vkMapMemory(device->device, pipeline->uniformBuffersMemory[Resource::currentImage], 0, sizeof(ubo), 0, &data);
-            memcpy(data, &ubo, sizeof(ubo));
-        vkUnmapMemory(device->device, pipeline->uniformBuffersMemory[Resource::currentImage]);
+        if(std::abs(sinY) < 0.9999f)
+            return glm::vec3(std::atan2(-m[2][1], m[2][2]), y, std::atan2(-m[1][0], m[0][0]));
 
+        return glm::vec3(std::atan2(m[1][2], m[1][1]), y, 0.0f);
     }
 
-    glm::vec3 size;
+    std::string vertFile, fragFile;   
+    
+    bool applyLight = false;
+
+    int layer = 0;
+
+    EntityId entity = NullEntity;
+    uint32_t transform;
 
-    glm::mat4 model;
-    glm::vec3 position;
-    glm::vec3 rotate;
+    inline static Registry* registry;
 };
\ No newline at end of file
@@ -0,0 +1,503 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "device.h"
+#include "tools.h"
+
+//Free-list sub-allocator over a linear range, units are up to the caller
+class RangeAllocator{
+public:
+    RangeAllocator(VkDeviceSize capacity = 0)
+    {
+        Reset(capacity);
+    }
+
+    void Reset(VkDeviceSize capacity)
+    {
+        this->capacity = capacity;
+        used = 0;
+        freeRanges.clear();
+
+        if(capacity > 0)
+            freeRanges.push_back({0, capacity});
+    }
+
+    bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+    {
+        for(size_t i = 0; i < freeRanges.size(); i++)
+        {
+            FreeRange range = freeRanges[i];
+
+            VkDeviceSize aligned = (range.offset + alignment - 1) / alignment * alignment;
+            VkDeviceSize padding = aligned - range.offset;
+
+            if(padding + size > range.size)
+                continue;
+
+            VkDeviceSize tail = range.size - padding - size;
+
+            freeRanges.erase(freeRanges.begin() + i);
+
+            if(tail > 0)
+                freeRanges.insert(freeRanges.begin() + i, {aligned + size, tail});
+            if(padding > 0)
+                freeRanges.insert(freeRanges.begin() + i, {range.offset, padding});
+
+            offset = aligned;
+            used += size;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    void Free(VkDeviceSize offset, VkDeviceSize size)
+    {
+        auto it = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset, [](const FreeRange& range, VkDeviceSize value){
+            return range.offset < value;
+        });
+
+        it = freeRanges.insert(it, {offset, size});
+        used -= size;
+
+        //Сливаем с соседями, чтобы не плодить мелкие дыры
+        auto next = it + 1;
+        if(next != freeRanges.end() && it->offset + it->size == next->offset)
+        {
+            it->size += next->size;
+            freeRanges.erase(next);
+        }
+
+        if(it != freeRanges.begin())
+        {
+            auto prev = it - 1;
+            if(prev->offset + prev->size == it->offset)
+            {
+                prev->size += it->size;
+                freeRanges.erase(it);
+            }
+        }
+    }
+
+    VkDeviceSize GetLargestFree()
+    {
+        VkDeviceSize largest = 0;
+        for(auto& range : freeRanges)
+            largest = std::max(largest, range.size);
+
+        return largest;
+    }
+
+    VkDeviceSize GetCapacity() { return capacity; }
+    VkDeviceSize GetUsed() { return used; }
+
+private:
+    struct FreeRange{
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    std::vector<FreeRange> freeRanges;
+
+    VkDeviceSize capacity;
+    VkDeviceSize used;
+};
+
+struct GeometryAllocation{
+    uint32_t block;
+
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    VkIndexType indexType;
+
+    bool alive;
+};
+
+//Вершины меша, разложенные по потокам: поток i уходит в binding i
+struct VertexStreams{
+    std::vector<uint32_t> strides;
+    std::vector<const void*> data;
+};
+
+//Shared vertex/index arena: meshes get ranges inside a few big device-local buffers,
+//so draws only pass firstIndex/vertexOffset and rebinding happens per block.
+//A block holds one buffer per vertex stream and serves a single set of stream strides;
+//vertex ranges are counted in vertices, so vertexOffset is valid for every stream at once
+class GeometryPool{
+public:
+    GeometryPool(Device* device, VkDeviceSize blockVertexBytes = 16 << 20, VkDeviceSize blockIndexBytes = 16 << 20)
+    {
+        this->device = device;
+        this->blockVertexBytes = blockVertexBytes;
+        this->blockIndexBytes = blockIndexBytes;
+
+        createBlock({sizeof(Vertex)}, blockVertexBytes / sizeof(Vertex), blockIndexBytes);
+    }
+    ~GeometryPool()
+    {
+        for(auto& block : blocks)
+            destroyBlock(block);
+    }
+
+    uint32_t Allocate(const std::vector<Vertex>& vertices, const void* indices, uint32_t indexCount, VkIndexType indexType)
+    {
+        return Allocate({{sizeof(Vertex)}, {vertices.data()}}, static_cast<uint32_t>(vertices.size()), indices, indexCount, indexType);
+    }
+
+    uint32_t Allocate(const VertexStreams& streams, uint32_t vertexCount, const void* indices, uint32_t indexCount, VkIndexType indexType)
+    {
+        VkDeviceSize indexStride = indexType == VK_INDEX_TYPE_UINT32 ? sizeof(uint32_t) : sizeof(uint16_t);
+        VkDeviceSize indexBytes = indexStride * indexCount;
+
+        GeometryAllocation allocation{};
+        allocation.vertexCount = vertexCount;
+        allocation.indexCount = indexCount;
+        allocation.indexType = indexType;
+        allocation.alive = true;
+
+        VkDeviceSize vertexOffset = 0, indexOffset = 0;
+
+        allocation.block = findBlock(streams.strides, vertexCount, indexBytes, indexStride, vertexOffset, indexOffset);
+        allocation.vertexOffset = static_cast<int32_t>(vertexOffset);
+        allocation.firstIndex = static_cast<uint32_t>(indexOffset / indexStride);
+
+        upload(blocks[allocation.block], streams, vertexOffset, vertexCount, indices, indexOffset, indexBytes);
+
+        uint32_t handle;
+        if(!freeHandles.empty())
+        {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+            allocations[handle] = allocation;
+        }
+        else
+        {
+            handle = static_cast<uint32_t>(allocations.size());
+            allocations.push_back(allocation);
+        }
+
+        return handle;
+    }
+
+    void Free(uint32_t handle)
+    {
+        GeometryAllocation& allocation = allocations[handle];
+
+        if(!allocation.alive)
+            return;
+
+        Block& block = blocks[allocation.block];
+
+        VkDeviceSize indexStride = allocation.indexType == VK_INDEX_TYPE_UINT32 ? sizeof(uint32_t) : sizeof(uint16_t);
+
+        if(allocation.vertexCount > 0)
+            block.vertices.Free(allocation.vertexOffset, allocation.vertexCount);
+        if(allocation.indexCount > 0)
+            block.indices.Free(allocation.firstIndex * indexStride, allocation.indexCount * indexStride);
+
+        allocation.alive = false;
+        freeHandles.push_back(handle);
+    }
+
+    const GeometryAllocation& Get(uint32_t handle)
+    {
+        return allocations[handle];
+    }
+
+    void ResetBindings()
+    {
+        boundBlock = UINT32_MAX;
+    }
+
+    //Привязывает все потоки блока с binding 0; пайплайн читает только те, что описаны в его vertex input
+    void Bind(VkCommandBuffer commandBuffer, const GeometryAllocation& allocation)
+    {
+        if(boundBlock == allocation.block && boundIndexType == allocation.indexType)
+            return;
+
+        Block& block = blocks[allocation.block];
+
+        std::vector<VkDeviceSize> offsets(block.streams.size(), 0);
+        std::vector<VkBuffer> vertexBuffers(block.streams.size());
+        for(size_t i = 0; i < block.streams.size(); i++)
+            vertexBuffers[i] = block.streams[i].buffer;
+
+        vkCmdBindVertexBuffers(commandBuffer, 0, static_cast<uint32_t>(vertexBuffers.size()), vertexBuffers.data(), offsets.data());
+        vkCmdBindIndexBuffer(commandBuffer, block.indexBuffer, 0, allocation.indexType);
+
+        boundBlock = allocation.block;
+        boundIndexType = allocation.indexType;
+    }
+
+    //Доля свободного места, которое уже не влезает одним куском
+    float GetFragmentation()
+    {
+        float worst = 0.0f;
+
+        for(auto& block : blocks)
+        {
+            VkDeviceSize free = block.vertices.GetCapacity() - block.vertices.GetUsed();
+            if(free == 0)
+                continue;
+
+            worst = std::max(worst, 1.0f - (float)block.vertices.GetLargestFree() / free);
+        }
+
+        return worst;
+    }
+
+    //Repacks every block front-to-back. Must run between frames, while no command buffer references the pool
+    void Compact()
+    {
+        vkQueueWaitIdle(device->graphicsQueue);
+
+        for(uint32_t b = 0; b < blocks.size(); b++)
+        {
+            Block& block = blocks[b];
+
+            if(block.indexBuffer == VK_NULL_HANDLE)
+                continue;
+
+            std::vector<uint32_t> live;
+            for(uint32_t i = 0; i < allocations.size(); i++)
+                if(allocations[i].alive && allocations[i].block == b)
+                    live.push_back(i);
+
+            if(live.empty() && b > 0)
+            {
+                destroyBlock(block);
+                continue;
+            }
+
+            std::sort(live.begin(), live.end(), [this](uint32_t a, uint32_t c){
+                return allocations[a].vertexOffset < allocations[c].vertexOffset;
+            });
+
+            Block packed{};
+            allocateBuffers(packed, block.strides, block.vertices.GetCapacity(), block.indices.GetCapacity());
+
+            std::vector<std::vector<VkBufferCopy>> vertexCopies(block.streams.size());
+            std::vector<VkBufferCopy> indexCopies;
+
+            for(uint32_t handle : live)
+            {
+                GeometryAllocation& allocation = allocations[handle];
+
+                VkDeviceSize indexStride = allocation.indexType == VK_INDEX_TYPE_UINT32 ? sizeof(uint32_t) : sizeof(uint16_t);
+                VkDeviceSize vertexOffset = 0, indexOffset = 0;
+
+                packed.vertices.Allocate(allocation.vertexCount, 1, vertexOffset);
+                packed.indices.Allocate(allocation.indexCount * indexStride, indexStride, indexOffset);
+
+                if(allocation.vertexCount > 0)
+                {
+                    for(size_t i = 0; i < block.streams.size(); i++)
+                    {
+                        VkDeviceSize stride = block.strides[i];
+                        vertexCopies[i].push_back({allocation.vertexOffset * stride, vertexOffset * stride, allocation.vertexCount * stride});
+                    }
+                }
+                if(allocation.indexCount > 0)
+                    indexCopies.push_back({allocation.firstIndex * indexStride, indexOffset, allocation.indexCount * indexStride});
+
+                allocation.vertexOffset = static_cast<int32_t>(vertexOffset);
+                allocation.firstIndex = static_cast<uint32_t>(indexOffset / indexStride);
+            }
+
+            VkCommandBuffer commandBuffer = Tools::beginSingleTimeCommands();
+
+            for(size_t i = 0; i < block.streams.size(); i++)
+            {
+                if(!vertexCopies[i].empty())
+                    vkCmdCopyBuffer(commandBuffer, block.streams[i].buffer, packed.streams[i].buffer, static_cast<uint32_t>(vertexCopies[i].size()), vertexCopies[i].data());
+            }
+            if(!indexCopies.empty())
+                vkCmdCopyBuffer(commandBuffer, block.indexBuffer, packed.indexBuffer, static_cast<uint32_t>(indexCopies.size()), indexCopies.data());
+
+            Tools::endSingleTimeCommands(commandBuffer);
+
+            destroyBlock(block);
+            block = packed;
+        }
+
+        ResetBindings();
+    }
+
+private:
+    struct Stream{
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+    };
+
+    struct Block{
+        std::vector<uint32_t> strides;
+        std::vector<Stream> streams;
+
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+
+        //В вершинах, общий для всех потоков
+        RangeAllocator vertices;
+        RangeAllocator indices;
+    };
+
+    uint32_t findBlock(const std::vector<uint32_t>& strides, uint32_t vertexCount, VkDeviceSize indexBytes, VkDeviceSize indexStride, VkDeviceSize& vertexOffset, VkDeviceSize& indexOffset)
+    {
+        for(uint32_t b = 0; b < blocks.size(); b++)
+        {
+            if(blocks[b].indexBuffer != VK_NULL_HANDLE && blocks[b].strides == strides && tryAllocate(blocks[b], vertexCount, indexBytes, indexStride, vertexOffset, indexOffset))
+                return b;
+        }
+
+        uint32_t vertexSize = 0;
+        for(uint32_t stride : strides)
+            vertexSize += stride;
+
+        //Меш больше стандартного блока получает свой блок по размеру
+        uint32_t b = createBlock(strides, std::max<VkDeviceSize>(blockVertexBytes / std::max<uint32_t>(vertexSize, 1), vertexCount), std::max(blockIndexBytes, indexBytes));
+
+        if(!tryAllocate(blocks[b], vertexCount, indexBytes, indexStride, vertexOffset, indexOffset))
+            throw std::runtime_error("failed to allocate geometry range!");
+
+        return b;
+    }
+
+    bool tryAllocate(Block& block, uint32_t vertexCount, VkDeviceSize indexBytes, VkDeviceSize indexStride, VkDeviceSize& vertexOffset, VkDeviceSize& indexOffset)
+    {
+        vertexOffset = 0;
+        indexOffset = 0;
+
+        if(vertexCount > 0 && !block.vertices.Allocate(vertexCount, 1, vertexOffset))
+            return false;
+
+        if(indexBytes > 0 && !block.indices.Allocate(indexBytes, indexStride, indexOffset))
+        {
+            if(vertexCount > 0)
+                block.vertices.Free(vertexOffset, vertexCount);
+            return false;
+        }
+
+        return true;
+    }
+
+    uint32_t createBlock(const std::vector<uint32_t>& strides, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity)
+    {
+        Block block{};
+        allocateBuffers(block, strides, vertexCapacity, indexCapacity);
+
+        for(uint32_t b = 0; b < blocks.size(); b++)
+        {
+            if(blocks[b].indexBuffer == VK_NULL_HANDLE)
+            {
+                blocks[b] = block;
+                return b;
+            }
+        }
+
+        blocks.push_back(block);
+        return static_cast<uint32_t>(blocks.size() - 1);
+    }
+
+    void allocateBuffers(Block& block, const std::vector<uint32_t>& strides, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity)
+    {
+        block.strides = strides;
+        block.streams.resize(strides.size());
+
+        for(size_t i = 0; i < strides.size(); i++)
+            Tools::createBuffer(vertexCapacity * strides[i], VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, block.streams[i].buffer, block.streams[i].memory);
+
+        Tools::createBuffer(indexCapacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, block.indexBuffer, block.indexBufferMemory);
+
+        block.vertices.Reset(vertexCapacity);
+        block.indices.Reset(indexCapacity);
+    }
+
+    void destroyBlock(Block& block)
+    {
+        if(block.indexBuffer == VK_NULL_HANDLE)
+            return;
+
+        for(auto& stream : block.streams)
+        {
+            vkDestroyBuffer(device->device, stream.buffer, nullptr);
+            vkFreeMemory(device->device, stream.memory, nullptr);
+        }
+        vkDestroyBuffer(device->device, block.indexBuffer, nullptr);
+        vkFreeMemory(device->device, block.indexBufferMemory, nullptr);
+
+        block.streams.clear();
+        block.indexBuffer = VK_NULL_HANDLE;
+        block.vertices.Reset(0);
+        block.indices.Reset(0);
+    }
+
+    void upload(Block& block, const VertexStreams& streams, VkDeviceSize vertexOffset, uint32_t vertexCount, const void* indices, VkDeviceSize indexOffset, VkDeviceSize indexBytes)
+    {
+        VkDeviceSize vertexBytes = 0;
+        for(uint32_t stride : streams.strides)
+            vertexBytes += (VkDeviceSize)stride * vertexCount;
+
+        VkDeviceSize bufferSize = vertexBytes + indexBytes;
+
+        if(bufferSize == 0)
+            return;
+
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        Tools::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+        void* data;
+        vkMapMemory(device->device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        {
+            char* out = (char*)data;
+            for(size_t i = 0; i < streams.strides.size(); i++)
+            {
+                memcpy(out, streams.data[i], (size_t)streams.strides[i] * vertexCount);
+                out += (size_t)streams.strides[i] * vertexCount;
+            }
+            memcpy(out, indices, (size_t) indexBytes);
+        }
+        vkUnmapMemory(device->device, stagingBufferMemory);
+
+        VkCommandBuffer commandBuffer = Tools::beginSingleTimeCommands();
+
+        VkDeviceSize source = 0;
+        for(size_t i = 0; i < streams.strides.size() && vertexCount > 0; i++)
+        {
+            VkDeviceSize stride = streams.strides[i];
+            VkBufferCopy copyRegion{source, vertexOffset * stride, vertexCount * stride};
+            vkCmdCopyBuffer(commandBuffer, stagingBuffer, block.streams[i].buffer, 1, &copyRegion);
+
+            source += vertexCount * stride;
+        }
+
+        if(indexBytes > 0)
+        {
+            VkBufferCopy copyRegion{vertexBytes, indexOffset, indexBytes};
+            vkCmdCopyBuffer(commandBuffer, stagingBuffer, block.indexBuffer, 1, &copyRegion);
+        }
+
+        Tools::endSingleTimeCommands(commandBuffer);
+
+        vkDestroyBuffer(device->device, stagingBuffer, nullptr);
+        vkFreeMemory(device->device, stagingBufferMemory, nullptr);
+    }
+
+    std::vector<Block> blocks;
+
+    std::vector<GeometryAllocation> allocations;
+    std::vector<uint32_t> freeHandles;
+
+    VkDeviceSize blockVertexBytes;
+    VkDeviceSize blockIndexBytes;
+
+    uint32_t boundBlock = UINT32_MAX;
+    VkIndexType boundIndexType = VK_INDEX_TYPE_UINT16;
+
+    Device* device;
+};
@@ -0,0 +1,444 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "json.h"
+#include "vfs.h"
+
+#include <memory>
+
+struct GltfPrimitive{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    int material = -1;
+};
+
+struct GltfMesh{
+    std::vector<GltfPrimitive> primitives;
+};
+
+struct GltfMaterial{
+    glm::vec4 baseColor = glm::vec4(1.0f);
+    int baseColorImage = -1;
+};
+
+//Картинка остаётся в отображённом файле, декодируется при создании текстуры
+struct GltfImage{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    std::string mimeType;
+};
+
+struct GltfNode{
+    glm::vec3 translation = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+    int mesh = -1;
+    std::vector<int> children;
+};
+
+struct GltfAsset{
+    std::vector<GltfMesh> meshes;
+    std::vector<GltfMaterial> materials;
+    std::vector<GltfImage> images;
+    std::vector<GltfNode> nodes;
+    std::vector<int> roots;
+
+    //Держит отображение, пока живут указатели images
+    std::shared_ptr<MappedFile> file;
+};
+
+//Загрузчик glTF 2.0 в бинарном контейнере (.glb). Бинарный блок не копируется: accessor'ы читаются
+//прямо из отображённого файла в чередующиеся Vertex, картинки отдаются указателями на него же
+class GltfLoader{
+public:
+    static void Load(const std::string& path, GltfAsset& asset)
+    {
+        asset = GltfAsset{};
+        asset.file = std::make_shared<MappedFile>();
+
+        if(!Vfs::Open(path, *asset.file))
+            throw std::runtime_error("failed to open " + path + "!");
+
+        const uint8_t* data = asset.file->GetData();
+        size_t size = asset.file->GetSize();
+
+        //Заголовок: magic, версия, длина; затем блоки JSON и BIN
+        uint32_t header[3];
+        if(size < sizeof(header))
+            throw std::runtime_error("failed to read GLB header!");
+        memcpy(header, data, sizeof(header));
+
+        if(header[0] != MagicGlb || header[1] != 2 || header[2] > size)
+            throw std::runtime_error("unsupported GLB file " + path + "!");
+
+        const char* json = nullptr;
+        size_t jsonSize = 0;
+
+        Buffer bin;
+
+        size_t offset = sizeof(header);
+        while(offset + 8 <= header[2])
+        {
+            uint32_t chunk[2];
+            memcpy(chunk, data + offset, sizeof(chunk));
+            offset += sizeof(chunk);
+
+            if(offset + chunk[0] > header[2])
+                throw std::runtime_error("failed to read GLB chunk!");
+
+            if(chunk[1] == ChunkJson)
+            {
+                json = reinterpret_cast<const char*>(data + offset);
+                jsonSize = chunk[0];
+            }
+            else if(chunk[1] == ChunkBin && bin.data == nullptr)
+                bin = {data + offset, chunk[0]};
+
+            offset += (chunk[0] + 3) & ~3u;
+        }
+
+        if(json == nullptr)
+            throw std::runtime_error("GLB file has no JSON chunk!");
+
+        JsonValue root;
+        std::string error;
+        if(!JsonValue::Parse(json, json + jsonSize, root, error))
+            throw std::runtime_error(error);
+
+        Document document{root, bin};
+
+        for(size_t i = 0; i < root["images"].Size(); i++)
+            asset.images.push_back(readImage(document, root["images"][i]));
+
+        for(size_t i = 0; i < root["materials"].Size(); i++)
+            asset.materials.push_back(readMaterial(root, root["materials"][i]));
+
+        for(size_t i = 0; i < root["meshes"].Size(); i++)
+            asset.meshes.push_back(readMesh(document, root["meshes"][i]));
+
+        for(size_t i = 0; i < root["nodes"].Size(); i++)
+            asset.nodes.push_back(readNode(root["nodes"][i]));
+
+        const JsonValue& scene = root["scenes"][root["scene"].AsInt(0)];
+        if(!scene.IsNull())
+        {
+            for(auto& node : scene["nodes"].array)
+                asset.roots.push_back(node.AsInt());
+        }
+        else
+        {
+            //Сцены нет - корнями считаются узлы, которые не дети других
+            std::vector<bool> child(asset.nodes.size(), false);
+            for(auto& node : asset.nodes)
+                for(int c : node.children)
+                    if(c >= 0 && c < (int)child.size())
+                        child[c] = true;
+
+            for(size_t i = 0; i < child.size(); i++)
+                if(!child[i])
+                    asset.roots.push_back(static_cast<int>(i));
+        }
+    }
+
+    inline static const uint32_t MagicGlb = 0x46546C67;    // "glTF"
+    inline static const uint32_t ChunkJson = 0x4E4F534A;   // "JSON"
+    inline static const uint32_t ChunkBin = 0x004E4942;    // "BIN\0"
+
+private:
+    struct Buffer{
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+    };
+
+    struct Document{
+        const JsonValue& root;
+        Buffer bin;
+    };
+
+    //Вид на accessor: указатель на первый элемент и шаг между элементами
+    struct Accessor{
+        const uint8_t* data = nullptr;
+        size_t count = 0;
+        size_t stride = 0;
+        int componentType = 0;
+        int components = 0;
+        bool normalized = false;
+    };
+
+    enum ComponentType{
+        Byte = 5120,
+        UnsignedByte = 5121,
+        Short = 5122,
+        UnsignedShort = 5123,
+        UnsignedInt = 5125,
+        Float = 5126
+    };
+
+    static size_t componentSize(int componentType)
+    {
+        switch(componentType)
+        {
+            case Byte: case UnsignedByte: return 1;
+            case Short: case UnsignedShort: return 2;
+            case UnsignedInt: case Float: return 4;
+            default: throw std::runtime_error("unsupported glTF component type!");
+        }
+    }
+
+    static int componentCount(const std::string& type)
+    {
+        if(type == "SCALAR") return 1;
+        if(type == "VEC2") return 2;
+        if(type == "VEC3") return 3;
+        if(type == "VEC4") return 4;
+        if(type == "MAT4") return 16;
+
+        throw std::runtime_error("unsupported glTF accessor type " + type + "!");
+    }
+
+    //Только буфер 0 без uri, то есть BIN-блок самого GLB
+    static Buffer bufferView(const Document& document, int index, size_t* stride = nullptr)
+    {
+        const JsonValue& view = document.root["bufferViews"][index];
+        if(view.IsNull())
+            throw std::runtime_error("glTF buffer view out of range!");
+
+        if(view["buffer"].AsInt() != 0 || document.bin.data == nullptr)
+            throw std::runtime_error("external glTF buffers are not supported!");
+
+        size_t offset = static_cast<size_t>(view["byteOffset"].number);
+        size_t length = static_cast<size_t>(view["byteLength"].number);
+
+        if(offset + length > document.bin.size)
+            throw std::runtime_error("glTF buffer view out of range!");
+
+        if(stride)
+            *stride = static_cast<size_t>(view["byteStride"].number);
+
+        return {document.bin.data + offset, length};
+    }
+
+    static Accessor accessor(const Document& document, int index)
+    {
+        const JsonValue& json = document.root["accessors"][index];
+        if(json.IsNull())
+            throw std::runtime_error("glTF accessor out of range!");
+
+        if(!json["sparse"].IsNull() || json["bufferView"].IsNull())
+            throw std::runtime_error("sparse glTF accessors are not supported!");
+
+        Accessor result;
+        result.count = static_cast<size_t>(json["count"].number);
+        result.componentType = json["componentType"].AsInt();
+        result.components = componentCount(json["type"].AsString());
+        result.normalized = json["normalized"].AsBool();
+
+        size_t elementSize = componentSize(result.componentType) * result.components;
+
+        Buffer view = bufferView(document, json["bufferView"].AsInt(), &result.stride);
+        if(result.stride == 0)
+            result.stride = elementSize;
+
+        size_t offset = static_cast<size_t>(json["byteOffset"].number);
+        if(result.count > 0 && offset + (result.count - 1) * result.stride + elementSize > view.size)
+            throw std::runtime_error("glTF accessor out of range!");
+
+        result.data = view.data + offset;
+        return result;
+    }
+
+    static float readComponent(const uint8_t* p, int componentType, bool normalized)
+    {
+        switch(componentType)
+        {
+            case Float: { float v; memcpy(&v, p, 4); return v; }
+            case UnsignedByte: return normalized ? *p / 255.0f : *p;
+            case Byte: { int8_t v = static_cast<int8_t>(*p); return normalized ? std::max(v / 127.0f, -1.0f) : v; }
+            case UnsignedShort: { uint16_t v; memcpy(&v, p, 2); return normalized ? v / 65535.0f : v; }
+            case Short: { int16_t v; memcpy(&v, p, 2); return normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+            case UnsignedInt: { uint32_t v; memcpy(&v, p, 4); return static_cast<float>(v); }
+            default: return 0.0f;
+        }
+    }
+
+    //Элемент accessor'а как вектор float; недостающие компоненты не трогаются
+    static void read(const Accessor& accessor, size_t index, float* out, int count)
+    {
+        const uint8_t* p = accessor.data + index * accessor.stride;
+        size_t size = componentSize(accessor.componentType);
+
+        if(accessor.componentType == Float)
+        {
+            memcpy(out, p, std::min(count, accessor.components) * sizeof(float));
+            return;
+        }
+
+        for(int i = 0; i < std::min(count, accessor.components); i++)
+            out[i] = readComponent(p + i * size, accessor.componentType, accessor.normalized);
+    }
+
+    static GltfPrimitive readPrimitive(const Document& document, const JsonValue& json)
+    {
+        GltfPrimitive primitive;
+        primitive.material = json["material"].AsInt(-1);
+
+        const JsonValue& attributes = json["attributes"];
+        if(attributes["POSITION"].IsNull())
+            return primitive;
+
+        Accessor positions = accessor(document, attributes["POSITION"].AsInt());
+
+        Accessor normals, texCoords, colors;
+        if(!attributes["NORMAL"].IsNull())
+            normals = accessor(document, attributes["NORMAL"].AsInt());
+        if(!attributes["TEXCOORD_0"].IsNull())
+            texCoords = accessor(document, attributes["TEXCOORD_0"].AsInt());
+        if(!attributes["COLOR_0"].IsNull())
+            colors = accessor(document, attributes["COLOR_0"].AsInt());
+
+        primitive.vertices.resize(positions.count);
+        for(size_t i = 0; i < positions.count; i++)
+        {
+            Vertex& vertex = primitive.vertices[i];
+            vertex.color = glm::vec3(1.0f);
+
+            read(positions, i, &vertex.pos.x, 3);
+            if(normals.data && i < normals.count)
+                read(normals, i, &vertex.normal.x, 3);
+            if(texCoords.data && i < texCoords.count)
+                read(texCoords, i, &vertex.texCoord.x, 2);
+            if(colors.data && i < colors.count)
+                read(colors, i, &vertex.color.x, 3);
+        }
+
+        if(!json["indices"].IsNull())
+        {
+            Accessor indices = accessor(document, json["indices"].AsInt());
+            primitive.indices.resize(indices.count);
+
+            for(size_t i = 0; i < indices.count; i++)
+            {
+                const uint8_t* p = indices.data + i * indices.stride;
+
+                if(indices.componentType == UnsignedShort)
+                {
+                    uint16_t v;
+                    memcpy(&v, p, 2);
+                    primitive.indices[i] = v;
+                }
+                else if(indices.componentType == UnsignedInt)
+                    memcpy(&primitive.indices[i], p, 4);
+                else
+                    primitive.indices[i] = *p;
+
+                if(primitive.indices[i] >= positions.count)
+                    throw std::runtime_error("glTF index out of range!");
+            }
+        }
+        else
+        {
+            primitive.indices.resize(positions.count);
+            for(uint32_t i = 0; i < positions.count; i++)
+                primitive.indices[i] = i;
+        }
+
+        primitive.indices.resize(primitive.indices.size() / 3 * 3);
+
+        return primitive;
+    }
+
+    static GltfMesh readMesh(const Document& document, const JsonValue& json)
+    {
+        GltfMesh mesh;
+
+        for(auto& primitive : json["primitives"].array)
+        {
+            //Только списки треугольников (mode 4, по умолчанию)
+            if(primitive["mode"].AsInt(4) != 4)
+            {
+                std::cerr << "glTF primitive mode " << primitive["mode"].AsInt() << " skipped" << std::endl;
+                continue;
+            }
+
+            mesh.primitives.push_back(readPrimitive(document, primitive));
+        }
+
+        return mesh;
+    }
+
+    static GltfMaterial readMaterial(const JsonValue& root, const JsonValue& json)
+    {
+        GltfMaterial material;
+
+        const JsonValue& pbr = json["pbrMetallicRoughness"];
+        const JsonValue& factor = pbr["baseColorFactor"];
+        for(int i = 0; i < 4 && i < (int)factor.Size(); i++)
+            material.baseColor[i] = factor[i].AsFloat(1.0f);
+
+        const JsonValue& texture = pbr["baseColorTexture"];
+        if(!texture.IsNull())
+            material.baseColorImage = root["textures"][texture["index"].AsInt()]["source"].AsInt(-1);
+
+        return material;
+    }
+
+    static GltfImage readImage(const Document& document, const JsonValue& json)
+    {
+        GltfImage image;
+        image.mimeType = json["mimeType"].AsString();
+
+        if(json["bufferView"].IsNull())
+        {
+            std::cerr << "glTF image " << json["uri"].AsString() << " is not embedded, skipped" << std::endl;
+            return image;
+        }
+
+        Buffer view = bufferView(document, json["bufferView"].AsInt());
+        image.data = view.data;
+        image.size = view.size;
+
+        return image;
+    }
+
+    static GltfNode readNode(const JsonValue& json)
+    {
+        GltfNode node;
+        node.mesh = json["mesh"].AsInt(-1);
+
+        for(auto& child : json["children"].array)
+            node.children.push_back(child.AsInt());
+
+        const JsonValue& matrix = json["matrix"];
+        if(matrix.Size() == 16)
+        {
+            //Матрица раскладывается на TRS, скос не поддерживается
+            glm::mat4 m;
+            for(int i = 0; i < 16; i++)
+                m[i / 4][i % 4] = matrix[i].AsFloat();
+
+            node.translation = glm::vec3(m[3]);
+            node.scale = glm::vec3(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+
+            glm::mat3 rotation(glm::vec3(m[0]) / node.scale.x, glm::vec3(m[1]) / node.scale.y, glm::vec3(m[2]) / node.scale.z);
+            node.rotation = glm::quat_cast(rotation);
+
+            return node;
+        }
+
+        const JsonValue& t = json["translation"];
+        if(t.Size() == 3)
+            node.translation = glm::vec3(t[0].AsFloat(), t[1].AsFloat(), t[2].AsFloat());
+
+        //В glTF кватернион хранится как x, y, z, w
+        const JsonValue& r = json["rotation"];
+        if(r.Size() == 4)
+            node.rotation = glm::quat(r[3].AsFloat(1.0f), r[0].AsFloat(), r[1].AsFloat(), r[2].AsFloat());
+
+        const JsonValue& s = json["scale"];
+        if(s.Size() == 3)
+            node.scale = glm::vec3(s[0].AsFloat(1.0f), s[1].AsFloat(1.0f), s[2].AsFloat(1.0f));
+
+        return node;
+    }
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "gameObject.h"
+#include "gltfLoader.h"
+#include "textureAtlas.h"
+#include "transform.h"
+
+//Содержимое .glb как набор GameObject: по объекту на каждый примитив каждого узла с мешем.
+//Узлы становятся трансформациями с той же иерархией, всё подвешено к корню сцены
+class GltfScene{
+public:
+    GltfScene(Device* device, Camera* camera)
+    {
+        this->device = device;
+        this->camera = camera;
+
+        root = Transforms::Create();
+    }
+    ~GltfScene()
+    {
+        for(auto object : objects)
+            delete object;
+
+        for(auto node : nodeTransforms)
+            Transforms::Destroy(node);
+
+        Transforms::Destroy(root);
+    }
+
+    void Load(std::string filepath)
+    {
+        GltfAsset asset;
+        GltfLoader::Load(filepath, asset);
+
+        source = filepath;
+
+        if(atlasTextures)
+            buildAtlas(asset);
+
+        nodeTransforms.assign(asset.nodes.size(), Transforms::NoParent);
+
+        for(int node : asset.roots)
+            createNode(asset, node, root, 0);
+
+        std::cout << filepath << ": " << asset.nodes.size() << " nodes, " << asset.meshes.size() << " meshes, "
+                  << asset.materials.size() << " materials, " << objects.size() << " objects" << std::endl;
+    }
+
+    void Init()
+    {
+        for(auto object : objects)
+            object->Init();
+    }
+
+    void SetPosition(glm::vec3 position)
+    {
+        Transforms::SetPosition(root, position / 10.0f);
+    }
+
+    void SetSize(glm::vec3 size)
+    {
+        Transforms::SetScale(root, size);
+    }
+
+    void SetRotation(glm::vec3 rotation)
+    {
+        Transforms::SetRotation(root, GameObject::EulerToQuat(rotation / 10.0f));
+    }
+
+    std::vector<GameObject*> objects;
+
+    uint32_t root;
+
+    //Меши из .glb обычно уже подготовлены экспортёром, поэтому по умолчанию грузятся как есть,
+    //одним LOD без перестановки индексов и мешлетов
+    inline static bool optimizeMeshes = false;
+
+    inline static const int MaxDepth = 64;
+
+    //Маленькие картинки материалов собираются в общие страницы атласа, развёртки пересчитываются
+    inline static bool atlasTextures = true;
+    inline static const uint32_t AtlasPageSize = 2048;
+    inline static const uint32_t AtlasPadding = 4;
+    inline static const int MaxAtlasImageSize = 512;
+
+private:
+    void createNode(const GltfAsset& asset, int index, uint32_t parent, int depth)
+    {
+        if(index < 0 || index >= (int)asset.nodes.size() || depth > MaxDepth)
+            throw std::runtime_error("glTF node hierarchy is broken!");
+
+        if(nodeTransforms[index] != Transforms::NoParent)
+            return;
+
+        const GltfNode& node = asset.nodes[index];
+
+        uint32_t transform = Transforms::Create(parent);
+        Transforms::SetPosition(transform, node.translation);
+        Transforms::SetRotation(transform, node.rotation);
+        Transforms::SetScale(transform, node.scale);
+        nodeTransforms[index] = transform;
+
+        if(node.mesh >= 0 && node.mesh < (int)asset.meshes.size())
+            for(auto& primitive : asset.meshes[node.mesh].primitives)
+                createObject(asset, primitive, transform);
+
+        for(int child : node.children)
+            createNode(asset, child, transform, depth + 1);
+    }
+
+    void createObject(const GltfAsset& asset, const GltfPrimitive& primitive, uint32_t parent)
+    {
+        if(primitive.indices.empty())
+            return;
+
+        GltfMaterial material;
+        if(primitive.material >= 0 && primitive.material < (int)asset.materials.size())
+            material = asset.materials[primitive.material];
+
+        GameObject* object = new GameObject(device, camera);
+        Transforms::SetParent(object->transform, parent);
+
+        const GltfImage* image = nullptr;
+        if(material.baseColorImage >= 0 && material.baseColorImage < (int)asset.images.size() && asset.images[material.baseColorImage].data)
+            image = &asset.images[material.baseColorImage];
+
+        auto region = image ? atlasRegions.find(material.baseColorImage) : atlasRegions.end();
+
+        std::vector<Vertex> vertices = primitive.vertices;
+        for(auto& vertex : vertices)
+            vertex.color *= glm::vec3(material.baseColor);
+
+        if(region != atlasRegions.end())
+            TextureAtlas::RemapTexCoords(vertices, region->second);
+
+        object->setVertex(vertices);
+        object->setIndices(primitive.indices);
+
+        if(!optimizeMeshes)
+            object->m_model->lods = {{0, static_cast<uint32_t>(primitive.indices.size()), 0.0f}};
+
+        //Примитивы с одной картинкой делят одну текстуру (или страницу атласа) через AssetCache
+        if(image)
+        {
+            object->SetShadersName("shaders/vert.spv", "shaders/frag.spv");
+
+            if(region != atlasRegions.end())
+                object->SetTexture(atlasPages[region->second.page]);
+            else
+                object->LoadTexture(source + "#" + std::to_string(material.baseColorImage), image->data, image->size);
+        }
+        else
+            object->SetShadersName("shaders/nTVert.spv", "shaders/nTFrag.spv");
+
+        //glTF: передняя грань против часовой стрелки
+        object->SetFrontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE);
+        object->applyLight = true;
+
+        objects.push_back(object);
+    }
+
+    //Картинки, которые используются только с развёрткой внутри [0, 1] и не больше MaxAtlasImageSize
+    void buildAtlas(const GltfAsset& asset)
+    {
+        std::vector<bool> used(asset.images.size(), false);
+        std::vector<bool> fits(asset.images.size(), true);
+
+        for(auto& mesh : asset.meshes)
+            for(auto& primitive : mesh.primitives)
+            {
+                if(primitive.material < 0 || primitive.material >= (int)asset.materials.size())
+                    continue;
+
+                int image = asset.materials[primitive.material].baseColorImage;
+                if(image < 0 || image >= (int)asset.images.size() || !asset.images[image].data)
+                    continue;
+
+                used[image] = true;
+                if(!TextureAtlas::FitsAtlas(primitive.vertices))
+                    fits[image] = false;
+            }
+
+        TextureAtlas atlas(AtlasPageSize, AtlasPadding);
+        std::vector<std::pair<int, uint32_t>> packed;
+
+        for(size_t i = 0; i < asset.images.size(); i++)
+        {
+            if(!used[i] || !fits[i])
+                continue;
+
+            int width, height, channels;
+            if(!stbi_info_from_memory(asset.images[i].data, static_cast<int>(asset.images[i].size), &width, &height, &channels) ||
+               width > MaxAtlasImageSize || height > MaxAtlasImageSize)
+                continue;
+
+            stbi_uc* pixels = stbi_load_from_memory(asset.images[i].data, static_cast<int>(asset.images[i].size), &width, &height, &channels, STBI_rgb_alpha);
+            if(!pixels)
+                continue;
+
+            packed.push_back({static_cast<int>(i), atlas.Add(pixels, width, height)});
+            stbi_image_free(pixels);
+        }
+
+        //Одна картинка в атласе ничего не экономит
+        if(packed.size() < 2 || !atlas.Build())
+            return;
+
+        for(size_t i = 0; i < atlas.pages.size(); i++)
+        {
+            TextureData data;
+            data.width = data.height = static_cast<int>(atlas.pages[i].size);
+            AssetLoader::CookTexture(atlas.pages[i].pixels.data(), data, TextureUsage::Color, atlas.GetMipLevels());
+
+            atlasPages.push_back(Entity::assets->GetTexture(source + "#atlas" + std::to_string(i), data));
+        }
+
+        for(auto& [image, index] : packed)
+            atlasRegions[image] = atlas.GetRegion(index);
+
+        std::cout << source << ": " << packed.size() << " images packed into " << atlas.pages.size() << " atlas pages" << std::endl;
+    }
+
+    Device* device;
+    Camera* camera;
+
+    std::vector<uint32_t> nodeTransforms;
+
+    std::vector<std::shared_ptr<Texture>> atlasPages;
+    std::unordered_map<int, AtlasRegion> atlasRegions;
+
+    std::string source;
+};
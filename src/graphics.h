@@ -53,6 +53,32 @@ public:
         }
         createCommandBuffers();
     }
+
+    //Пересобирает только пайплайны, которые используют изменённый шейдер; вернёт их число
+    uint32_t ReloadShader(const std::string& path)
+    {
+        std::string changed = AssetPack::NormalizePath(path);
+        uint32_t rebuilt = 0;
+
+        for(auto go : gameObjects)
+        {
+            if(AssetPack::NormalizePath(go->vertFile) != changed && AssetPack::NormalizePath(go->fragFile) != changed)
+                continue;
+
+            if(renderer->rebuildGraphicsPipeline(go->vertFile, go->fragFile, go->pipeline))
+                rebuilt++;
+        }
+
+        return rebuilt;
+    }
+
+    //Texture подменила картинку на месте: пайплайны, смотревшие на старый вид, переписывают дескрипторы
+    void RebindTexture(VkImageView oldView)
+    {
+        for(auto go : gameObjects)
+            if(go->pipeline->textureImageView == oldView && go->texture)
+                go->SetTexture(go->texture);
+    }
     
     void createFramebuffers() {
         swapChainFramebuffers.resize(Resource::countFrames);
@@ -127,6 +153,8 @@ public:
             renderPassInfo.pClearValues = clearValues.data();
             vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
+            Model::pool->ResetBindings();
+
             for(auto go : gameObjects)
             {
                 vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, go->pipeline->graphicsPipeline);
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "fileWatcher.h"
+#include "graphics.h"
+#include "assetCache.h"
+#include "textureStreamer.h"
+#include "meshletRenderer.h"
+#include "registry.h"
+#include "components.h"
+
+//Подхватывает правки ассетов без перезапуска. Шейдеры пересобираются сразу (только затронутые
+//пайплайны, через общий кэш пайплайнов), картинки и модели перечитываются на пуле AssetLoader
+//и подменяются в его Update. Старые ресурсы удаляются через DeletionQueue, когда их уже не
+//читает ни один кадр. Задержка - от того, как изменение замечено, до подмены
+class HotReload{
+public:
+    HotReload(Graphics* graphics, MeshletRenderer* meshletRenderer, AssetLoader* loader, TextureStreamer* streamer, Registry* registry)
+    {
+        this->graphics = graphics;
+        this->meshletRenderer = meshletRenderer;
+        this->loader = loader;
+        this->streamer = streamer;
+        this->registry = registry;
+
+        watcher.WatchDirectory("shaders", {".spv"});
+        watcher.WatchDirectory("textures", {".png", ".jpg", ".jpeg", ".tga", ".bmp"});
+        watcher.WatchDirectory("models", {".obj"});
+    }
+
+    //Главный поток, раз в кадр до AssetLoader::Update
+    void Update()
+    {
+        for(auto& change : watcher.Poll())
+            reload(change);
+    }
+
+    //Для отладочного окна
+    uint32_t reloads = 0;
+    uint32_t failures = 0;
+    float lastLatency = 0.0f;
+    float maxLatency = 0.0f;
+    std::string lastPath;
+
+private:
+    void reload(const FileChange& change)
+    {
+        const std::string& path = change.path;
+        auto detected = change.detected;
+
+        //Изменённый файл новее пака, дальше он читается с диска
+        Vfs::PreferLoose(path);
+
+        auto onFailed = [this, path]{
+            failures++;
+            std::cerr << "hot reload: failed to reload " << path << std::endl;
+        };
+
+        if(endsWith(path, ".spv"))
+        {
+            uint32_t rebuilt = graphics->ReloadShader(path);
+            if(meshletRenderer->ReloadShader(path))
+                rebuilt++;
+            if(rebuilt > 0)
+                finish(path, detected, std::to_string(rebuilt) + " pipelines");
+            return;
+        }
+
+        if(endsWith(path, ".obj"))
+        {
+            Entity::assets->ReloadModel(*loader, path, [this, path, detected](Model* model){
+                updateBounds(model);
+                finish(path, detected, "model");
+            }, onFailed);
+            return;
+        }
+
+        Entity::assets->ReloadTexture(*loader, path, [this, path, detected](VkImageView oldView){
+            graphics->RebindTexture(oldView);
+            finish(path, detected, "texture");
+        }, onFailed);
+
+        streamer->Reload(*loader, path, [this, path, detected]{
+            finish(path, detected, "streamed texture");
+        }, onFailed);
+    }
+
+    //Сферы отсечения у всех сущностей с этой моделью
+    void updateBounds(Model* model)
+    {
+        registry->Each<RenderComponent, BoundsComponent>([model](EntityId, RenderComponent& render, BoundsComponent& bounds){
+            if(render.model == model)
+                bounds = {model->boundsCenter, model->boundsRadius};
+        });
+    }
+
+    void finish(const std::string& path, std::chrono::steady_clock::time_point detected, const std::string& what)
+    {
+        lastLatency = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - detected).count();
+        maxLatency = std::max(maxLatency, lastLatency);
+        lastPath = path;
+        reloads++;
+
+        std::cout << "hot reload: " << path << " (" << what << ") in " << lastLatency << " ms" << std::endl;
+    }
+
+    static bool endsWith(const std::string& path, const std::string& suffix)
+    {
+        return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    FileWatcher watcher;
+
+    Graphics* graphics;
+    MeshletRenderer* meshletRenderer;
+    AssetLoader* loader;
+    TextureStreamer* streamer;
+    Registry* registry;
+};
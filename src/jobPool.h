@@ -0,0 +1,147 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+
+//Пул с отдельной очередью у каждого потока. Задачи раскладываются по очередям по кругу,
+//поток берёт из своей самую срочную, а когда своя пуста - крадёт самую срочную у соседа,
+//так что общий замок на каждую задачу не нужен. Задача получает номер потока, чтобы
+//брать его рабочую память без блокировок. priority - чем меньше, тем раньше
+class JobPool{
+public:
+    JobPool(uint32_t threadCount = 0)
+    {
+        if(threadCount == 0)
+            threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+        for(uint32_t i = 0; i < threadCount; i++)
+            workers.push_back(std::make_unique<Worker>());
+
+        for(uint32_t i = 0; i < threadCount; i++)
+            workers[i]->thread = std::thread([this, i]{ run(i); });
+    }
+    ~JobPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        for(auto& worker : workers)
+            worker->thread.join();
+    }
+
+    JobPool(const JobPool&) = delete;
+    JobPool& operator=(const JobPool&) = delete;
+
+    void Submit(std::function<void(uint32_t)> job, float priority)
+    {
+        Worker& worker = *workers[next++ % workers.size()];
+
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.jobs.push_back({priority, order++, std::move(job)});
+            std::push_heap(worker.jobs.begin(), worker.jobs.end(), later);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            queued++;
+        }
+
+        wake.notify_one();
+    }
+
+    uint32_t GetThreadCount() const
+    {
+        return static_cast<uint32_t>(workers.size());
+    }
+
+    //Задачи, которые ещё не начаты
+    uint32_t GetQueuedCount() const
+    {
+        return static_cast<uint32_t>(std::max(queued.load(), 0));
+    }
+
+private:
+    struct Job{
+        float priority;
+        uint64_t order;
+        std::function<void(uint32_t)> run;
+    };
+
+    struct Worker{
+        std::mutex mutex;
+        std::vector<Job> jobs;
+        std::thread thread;
+    };
+
+    //Куча с самой срочной задачей наверху; при равных - кто раньше пришёл
+    static bool later(const Job& a, const Job& b)
+    {
+        if(a.priority != b.priority)
+            return a.priority > b.priority;
+        return a.order > b.order;
+    }
+
+    static bool pop(Worker& worker, Job& job)
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if(worker.jobs.empty())
+            return false;
+
+        std::pop_heap(worker.jobs.begin(), worker.jobs.end(), later);
+        job = std::move(worker.jobs.back());
+        worker.jobs.pop_back();
+        return true;
+    }
+
+    bool take(uint32_t index, Job& job)
+    {
+        if(pop(*workers[index], job))
+            return true;
+
+        for(size_t i = 1; i < workers.size(); i++)
+            if(pop(*workers[(index + i) % workers.size()], job))
+                return true;
+
+        return false;
+    }
+
+    //Оставшиеся задачи при остановке выбрасываются
+    void run(uint32_t index)
+    {
+        while(!stopping)
+        {
+            Job job;
+            if(take(index, job))
+            {
+                queued--;
+                job.run(index);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this]{ return stopping || queued.load() > 0; });
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::atomic<uint32_t> next{0};
+    std::atomic<uint64_t> order{0};
+    //Со знаком: поток может снять задачу раньше, чем Submit её посчитает
+    std::atomic<int32_t> queued{0};
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<bool> stopping{false};
+};
@@ -0,0 +1,303 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include <charconv>
+
+//Минимальный JSON: дерево значений, ключи объекта хранятся в порядке появления.
+//Нужен для заголовков glTF, поэтому без записи и без потоковой выдачи
+class JsonValue{
+public:
+    enum class Type{
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    //Отсутствующий ключ или индекс дают null, так что цепочки obj["a"]["b"] безопасны
+    const JsonValue& operator[](const std::string& key) const
+    {
+        for(auto& [name, value] : object)
+            if(name == key)
+                return value;
+
+        return null();
+    }
+
+    const JsonValue& operator[](size_t index) const
+    {
+        return index < array.size() ? array[index] : null();
+    }
+
+    bool IsNull() const { return type == Type::Null; }
+    size_t Size() const { return type == Type::Array ? array.size() : object.size(); }
+
+    int AsInt(int defaultValue = 0) const
+    {
+        return type == Type::Number ? static_cast<int>(number) : defaultValue;
+    }
+
+    float AsFloat(float defaultValue = 0.0f) const
+    {
+        return type == Type::Number ? static_cast<float>(number) : defaultValue;
+    }
+
+    bool AsBool(bool defaultValue = false) const
+    {
+        return type == Type::Bool ? boolean : defaultValue;
+    }
+
+    const std::string& AsString() const
+    {
+        return string;
+    }
+
+    static bool Parse(const char* begin, const char* end, JsonValue& value, std::string& error)
+    {
+        Reader reader{begin, end};
+
+        if(!reader.parseValue(value, 0) || (reader.skipSpaces(), reader.p != end))
+        {
+            error = "failed to parse JSON at offset " + std::to_string(reader.p - begin) + "!";
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+    static const JsonValue& null()
+    {
+        static const JsonValue value;
+        return value;
+    }
+
+    struct Reader{
+        const char* p;
+        const char* end;
+
+        inline static const int MaxDepth = 128;
+
+        void skipSpaces()
+        {
+            while(p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+                p++;
+        }
+
+        bool match(const char* word)
+        {
+            size_t length = strlen(word);
+            if(static_cast<size_t>(end - p) < length || memcmp(p, word, length) != 0)
+                return false;
+
+            p += length;
+            return true;
+        }
+
+        bool parseValue(JsonValue& value, int depth)
+        {
+            skipSpaces();
+            if(p >= end || depth > MaxDepth)
+                return false;
+
+            switch(*p)
+            {
+                case '{': return parseObject(value, depth);
+                case '[': return parseArray(value, depth);
+                case '"': value.type = Type::String; return parseString(value.string);
+                case 't': value.type = Type::Bool; value.boolean = true; return match("true");
+                case 'f': value.type = Type::Bool; value.boolean = false; return match("false");
+                case 'n': value.type = Type::Null; return match("null");
+                default: return parseNumber(value);
+            }
+        }
+
+        bool parseNumber(JsonValue& value)
+        {
+            value.type = Type::Number;
+
+            auto result = std::from_chars(p, end, value.number);
+            if(result.ec != std::errc())
+                return false;
+
+            p = result.ptr;
+            return true;
+        }
+
+        bool parseObject(JsonValue& value, int depth)
+        {
+            value.type = Type::Object;
+            p++;
+
+            skipSpaces();
+            if(p < end && *p == '}')
+            {
+                p++;
+                return true;
+            }
+
+            while(true)
+            {
+                skipSpaces();
+
+                std::string key;
+                if(p >= end || *p != '"' || !parseString(key))
+                    return false;
+
+                skipSpaces();
+                if(p >= end || *p != ':')
+                    return false;
+                p++;
+
+                value.object.emplace_back(std::move(key), JsonValue());
+                if(!parseValue(value.object.back().second, depth + 1))
+                    return false;
+
+                skipSpaces();
+                if(p >= end)
+                    return false;
+                if(*p == '}')
+                {
+                    p++;
+                    return true;
+                }
+                if(*p != ',')
+                    return false;
+                p++;
+            }
+        }
+
+        bool parseArray(JsonValue& value, int depth)
+        {
+            value.type = Type::Array;
+            p++;
+
+            skipSpaces();
+            if(p < end && *p == ']')
+            {
+                p++;
+                return true;
+            }
+
+            while(true)
+            {
+                value.array.emplace_back();
+                if(!parseValue(value.array.back(), depth + 1))
+                    return false;
+
+                skipSpaces();
+                if(p >= end)
+                    return false;
+                if(*p == ']')
+                {
+                    p++;
+                    return true;
+                }
+                if(*p != ',')
+                    return false;
+                p++;
+            }
+        }
+
+        bool parseString(std::string& out)
+        {
+            p++;
+
+            while(p < end && *p != '"')
+            {
+                if(*p != '\\')
+                {
+                    out += *p++;
+                    continue;
+                }
+
+                if(++p >= end)
+                    return false;
+
+                switch(*p++)
+                {
+                    case '"': out += '"'; break;
+                    case '\\': out += '\\'; break;
+                    case '/': out += '/'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'n': out += '\n'; break;
+                    case 'r': out += '\r'; break;
+                    case 't': out += '\t'; break;
+                    case 'u':
+                    {
+                        uint32_t code;
+                        if(!parseHex(code))
+                            return false;
+
+                        //Суррогатная пара UTF-16
+                        if(code >= 0xD800 && code < 0xDC00 && match("\\u"))
+                        {
+                            uint32_t low;
+                            if(!parseHex(low))
+                                return false;
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        }
+
+                        appendUtf8(out, code);
+                        break;
+                    }
+                    default: return false;
+                }
+            }
+
+            if(p >= end)
+                return false;
+
+            p++;
+            return true;
+        }
+
+        bool parseHex(uint32_t& code)
+        {
+            if(end - p < 4)
+                return false;
+
+            auto result = std::from_chars(p, p + 4, code, 16);
+            if(result.ec != std::errc() || result.ptr != p + 4)
+                return false;
+
+            p += 4;
+            return true;
+        }
+
+        static void appendUtf8(std::string& out, uint32_t code)
+        {
+            if(code < 0x80)
+                out += static_cast<char>(code);
+            else if(code < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (code >> 6));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else if(code < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (code >> 12));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (code >> 18));
+                out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+    };
+};
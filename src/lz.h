@@ -0,0 +1,166 @@
+#pragma once
+
+#include "stdinclude.h"
+
+//Сжатие в формате блока LZ4: токен (длина литералов | длина совпадения - 4), литералы,
+//смещение назад 2 байта, продолжения длин байтами по 255. Распаковка - только копирования,
+//быстрее чтения с диска, поэтому в паке сжимается то, что от этого заметно уменьшается
+class Lz{
+public:
+    static std::vector<uint8_t> Compress(const uint8_t* src, size_t size)
+    {
+        std::vector<uint8_t> out;
+        out.reserve(size / 2 + 16);
+
+        std::vector<uint32_t> table(HashSize, UINT32_MAX);
+
+        size_t anchor = 0;
+        size_t i = 0;
+
+        //Последнее совпадение должно кончаться не ближе LastLiterals к концу
+        size_t limit = size > MinTail ? size - MinTail : 0;
+
+        while(i < limit)
+        {
+            uint32_t sequence = read32(src + i);
+            uint32_t& slot = table[hash(sequence)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(i);
+
+            if(candidate == UINT32_MAX || i - candidate > MaxOffset || read32(src + candidate) != sequence)
+            {
+                i++;
+                continue;
+            }
+
+            size_t matchEnd = size - LastLiterals;
+            size_t length = MinMatch;
+            while(i + length < matchEnd && src[candidate + length] == src[i + length])
+                length++;
+
+            writeSequence(out, src + anchor, i - anchor, static_cast<uint16_t>(i - candidate), length);
+
+            i += length;
+            anchor = i;
+        }
+
+        //Хвост - одни литералы
+        size_t literals = size - anchor;
+        out.push_back(static_cast<uint8_t>(std::min<size_t>(literals, 15) << 4));
+        writeLength(out, literals);
+        out.insert(out.end(), src + anchor, src + size);
+
+        return out;
+    }
+
+    //false, если данные битые или не совпал размер
+    static bool Decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dstSize)
+    {
+        const uint8_t* end = src + size;
+        uint8_t* out = dst;
+        uint8_t* outEnd = dst + dstSize;
+
+        while(src < end)
+        {
+            uint8_t token = *src++;
+
+            size_t literals = token >> 4;
+            if(literals == 15 && !readLength(src, end, literals))
+                return false;
+
+            if(literals > static_cast<size_t>(end - src) || literals > static_cast<size_t>(outEnd - out))
+                return false;
+
+            memcpy(out, src, literals);
+            out += literals;
+            src += literals;
+
+            if(src == end)
+                break;
+
+            if(end - src < 2)
+                return false;
+
+            size_t offset = src[0] | (src[1] << 8);
+            src += 2;
+
+            size_t length = token & 15;
+            if(length == 15 && !readLength(src, end, length))
+                return false;
+            length += MinMatch;
+
+            if(offset == 0 || offset > static_cast<size_t>(out - dst) || length > static_cast<size_t>(outEnd - out))
+                return false;
+
+            //Совпадение может перекрываться с собой, поэтому побайтно
+            const uint8_t* match = out - offset;
+            for(size_t k = 0; k < length; k++)
+                out[k] = match[k];
+            out += length;
+        }
+
+        return out == outEnd;
+    }
+
+private:
+    static uint32_t read32(const uint8_t* p)
+    {
+        uint32_t value;
+        memcpy(&value, p, 4);
+        return value;
+    }
+
+    static uint32_t hash(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - HashBits);
+    }
+
+    static void writeLength(std::vector<uint8_t>& out, size_t length)
+    {
+        if(length < 15)
+            return;
+
+        length -= 15;
+        while(length >= 255)
+        {
+            out.push_back(255);
+            length -= 255;
+        }
+        out.push_back(static_cast<uint8_t>(length));
+    }
+
+    static bool readLength(const uint8_t*& src, const uint8_t* end, size_t& length)
+    {
+        uint8_t byte;
+        do{
+            if(src >= end)
+                return false;
+
+            byte = *src++;
+            length += byte;
+        }while(byte == 255);
+
+        return true;
+    }
+
+    static void writeSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, uint16_t offset, size_t matchLength)
+    {
+        size_t match = matchLength - MinMatch;
+
+        out.push_back(static_cast<uint8_t>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(match, 15)));
+        writeLength(out, literalCount);
+        out.insert(out.end(), literals, literals + literalCount);
+
+        out.push_back(static_cast<uint8_t>(offset & 0xFF));
+        out.push_back(static_cast<uint8_t>(offset >> 8));
+        writeLength(out, match);
+    }
+
+    inline static const size_t MinMatch = 4;
+    inline static const size_t LastLiterals = 5;
+    inline static const size_t MinTail = 12;
+    inline static const size_t MaxOffset = 65535;
+
+    inline static const uint32_t HashBits = 16;
+    inline static const size_t HashSize = size_t(1) << HashBits;
+};
@@ -1,6 +1,24 @@
 #include "engine.h"
 
-int main() {
+//Каталоги ассетов, которые читаются через Vfs; пути в паке - от рабочего каталога
+static const std::vector<std::string> PackDirectories = {"shaders", "textures", "models"};
+
+int main(int argc, char** argv) {
+    //--build-pack [файл]: собрать пак из ассетов рабочего каталога и выйти
+    if(argc > 1 && std::string(argv[1]) == "--build-pack")
+    {
+        std::string packPath = argc > 2 ? argv[2] : "assets.pack";
+
+        if(!AssetPack::Build(packPath, ".", true, PackDirectories))
+        {
+            std::cerr << "failed to build " << packPath << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::cout << packPath << ": built" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
     Engine* engine = new Engine();
 
     engine->Init();
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include <memory>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+//Файл, отображённый в память только для чтения. Страницы подгружает ОС по мере обращения
+class MappedFile{
+public:
+    MappedFile(){}
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path)
+    {
+        Close();
+
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if(file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            Close();
+            return false;
+        }
+
+        size = static_cast<size_t>(fileSize.QuadPart);
+
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping == nullptr)
+        {
+            Close();
+            return false;
+        }
+
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        file = open(path.c_str(), O_RDONLY);
+        if(file < 0)
+            return false;
+
+        struct stat info;
+        if(fstat(file, &info) != 0 || info.st_size == 0)
+        {
+            Close();
+            return false;
+        }
+
+        size = static_cast<size_t>(info.st_size);
+
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        data = view == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(view);
+#endif
+
+        if(data == nullptr)
+        {
+            Close();
+            return false;
+        }
+
+        return true;
+    }
+
+    //Вид на чужую память, например запись в отображённом паке или распакованный буфер;
+    //owner держит эту память, пока открыт вид
+    void OpenView(const uint8_t* data, size_t size, std::shared_ptr<const void> owner)
+    {
+        Close();
+
+        this->data = data;
+        this->size = size;
+        this->owner = owner;
+    }
+
+    void Close()
+    {
+        if(owner)
+        {
+            owner.reset();
+            data = nullptr;
+            size = 0;
+            return;
+        }
+
+#ifdef _WIN32
+        if(data)
+            UnmapViewOfFile(data);
+        if(mapping)
+            CloseHandle(mapping);
+        if(file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if(data)
+            munmap(const_cast<uint8_t*>(data), size);
+        if(file >= 0)
+            close(file);
+
+        file = -1;
+#endif
+
+        data = nullptr;
+        size = 0;
+    }
+
+    const uint8_t* GetData() const { return data; }
+    size_t GetSize() const { return size; }
+    bool IsOpen() const { return data != nullptr; }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    std::shared_ptr<const void> owner;
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int file = -1;
+#endif
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "model.h"
+#include "vfs.h"
+
+//Заголовок файла .mesh; после него блоки данных, каждый выровнен на 16 байт
+struct MeshCacheHeader{
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+
+    //Раскладка блока вершин
+    uint8_t position;
+    uint8_t normal;
+    uint8_t color;
+    uint8_t texCoord;
+    uint8_t splitPositions;
+    uint8_t padding[3];
+
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexType;
+    uint32_t lodCount;
+    uint32_t meshletCount;
+
+    float boundsMin[3];
+    float boundsMax[3];
+    float boundsCenter[3];
+    float boundsRadius;
+
+    MeshStats stats;
+
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t lodOffset;
+    uint64_t meshletOffset;
+};
+
+//Готовый к загрузке меш: сваренные и оптимизированные вершины, индексы всех LOD, мешлеты и границы.
+//При чтении файл отображается в память, и вершины с индексами идут в staging-буфер без разбора
+class MeshCache{
+public:
+    inline static const uint32_t Version = 1;
+
+    static std::string GetPath(const std::string& sourcePath)
+    {
+        return sourcePath + ".mesh";
+    }
+
+    //Хэш содержимого файла по 8 байт за шаг (FNV-подобное перемешивание); 0 - файла нет
+    static uint64_t HashFile(const std::string& path)
+    {
+        MappedFile file;
+        if(!Vfs::Open(path, file))
+            return 0;
+
+        const uint8_t* data = file.GetData();
+        size_t size = file.GetSize();
+
+        uint64_t hash = 14695981039346656037ull ^ size;
+
+        size_t i = 0;
+        for(; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+
+            hash = (hash ^ word) * 1099511628211ull;
+            hash ^= hash >> 32;
+        }
+
+        for(; i < size; i++)
+            hash = (hash ^ data[i]) * 1099511628211ull;
+
+        return hash;
+    }
+
+    static bool Load(const std::string& path, uint64_t sourceHash, Model& model)
+    {
+        auto file = std::make_shared<MappedFile>();
+        if(!Vfs::Open(path, *file) || file->GetSize() < sizeof(MeshCacheHeader))
+            return false;
+
+        MeshCacheHeader header;
+        memcpy(&header, file->GetData(), sizeof(header));
+
+        if(memcmp(header.magic, "VTMC", 4) != 0 || header.version != Version || header.sourceHash != sourceHash)
+            return false;
+
+        VertexLayout layout{(PositionFormat)header.position, (NormalFormat)header.normal, (ColorFormat)header.color, (TexCoordFormat)header.texCoord, header.splitPositions != 0};
+        if(layout != VertexLayout::Full())
+            return false;
+
+        VkDeviceSize indexStride = header.indexType == VK_INDEX_TYPE_UINT32 ? sizeof(uint32_t) : sizeof(uint16_t);
+
+        if(header.vertexOffset + (uint64_t)header.vertexCount * sizeof(Vertex) > file->GetSize() ||
+           header.indexOffset + (uint64_t)header.indexCount * indexStride > file->GetSize() ||
+           header.lodOffset + (uint64_t)header.lodCount * sizeof(ModelLod) > file->GetSize() ||
+           header.meshletOffset + (uint64_t)header.meshletCount * sizeof(Meshlet) > file->GetSize())
+            return false;
+
+        const uint8_t* data = file->GetData();
+
+        model.vertices.clear();
+        model.indices.clear();
+
+        model.lods.resize(header.lodCount);
+        memcpy(model.lods.data(), data + header.lodOffset, header.lodCount * sizeof(ModelLod));
+
+        model.meshlets.resize(header.meshletCount);
+        //glm::vec4 формально не тривиально копируется, но раскладка у Meshlet плоская
+        memcpy(static_cast<void*>(model.meshlets.data()), data + header.meshletOffset, header.meshletCount * sizeof(Meshlet));
+
+        model.stats = header.stats;
+        model.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+        model.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+        model.boundsCenter = glm::vec3(header.boundsCenter[0], header.boundsCenter[1], header.boundsCenter[2]);
+        model.boundsRadius = header.boundsRadius;
+
+        model.indexType = (VkIndexType)header.indexType;
+        model.cachedVertices = reinterpret_cast<const Vertex*>(data + header.vertexOffset);
+        model.cachedVertexCount = header.vertexCount;
+        model.cachedIndices = data + header.indexOffset;
+        model.cachedIndexCount = header.indexCount;
+        model.cacheFile = file;
+
+        return true;
+    }
+
+    //Модель должна быть уже оптимизирована (Model::Optimize), иначе в кэш попадёт сырая геометрия
+    static bool Save(const std::string& path, uint64_t sourceHash, const Model& model)
+    {
+        MeshCacheHeader header{};
+        memcpy(header.magic, "VTMC", 4);
+        header.version = Version;
+        header.sourceHash = sourceHash;
+
+        VertexLayout layout = VertexLayout::Full();
+        header.position = (uint8_t)layout.position;
+        header.normal = (uint8_t)layout.normal;
+        header.color = (uint8_t)layout.color;
+        header.texCoord = (uint8_t)layout.texCoord;
+        header.splitPositions = layout.splitPositions;
+
+        header.vertexCount = static_cast<uint32_t>(model.vertices.size());
+        header.indexCount = static_cast<uint32_t>(model.indices.size());
+        header.indexType = MeshOptimizer::IndexTypeFor(model.vertices.size());
+        header.lodCount = static_cast<uint32_t>(model.lods.size());
+        header.meshletCount = static_cast<uint32_t>(model.meshlets.size());
+
+        for(int i = 0; i < 3; i++)
+        {
+            header.boundsMin[i] = model.boundsMin[i];
+            header.boundsMax[i] = model.boundsMax[i];
+            header.boundsCenter[i] = model.boundsCenter[i];
+        }
+        header.boundsRadius = model.boundsRadius;
+        header.stats = model.stats;
+
+        std::vector<uint16_t> packed;
+        const void* indexData = model.indices.data();
+        size_t indexBytes = model.indices.size() * sizeof(uint32_t);
+
+        if(header.indexType == VK_INDEX_TYPE_UINT16)
+        {
+            packed.assign(model.indices.begin(), model.indices.end());
+            indexData = packed.data();
+            indexBytes = packed.size() * sizeof(uint16_t);
+        }
+
+        uint64_t offset = align(sizeof(MeshCacheHeader));
+        header.vertexOffset = offset;
+        offset = align(offset + model.vertices.size() * sizeof(Vertex));
+        header.indexOffset = offset;
+        offset = align(offset + indexBytes);
+        header.lodOffset = offset;
+        offset = align(offset + model.lods.size() * sizeof(ModelLod));
+        header.meshletOffset = offset;
+        offset += model.meshlets.size() * sizeof(Meshlet);
+
+        std::vector<uint8_t> data(offset, 0);
+        memcpy(data.data(), &header, sizeof(header));
+        memcpy(data.data() + header.vertexOffset, model.vertices.data(), model.vertices.size() * sizeof(Vertex));
+        memcpy(data.data() + header.indexOffset, indexData, indexBytes);
+        memcpy(data.data() + header.lodOffset, model.lods.data(), model.lods.size() * sizeof(ModelLod));
+        memcpy(data.data() + header.meshletOffset, model.meshlets.data(), model.meshlets.size() * sizeof(Meshlet));
+
+        //Пишем во временный файл и подменяем, чтобы оборванная запись не оставила битый кэш
+        std::string temp = path + ".tmp";
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if(!file)
+                return false;
+
+            file.write(reinterpret_cast<const char*>(data.data()), data.size());
+            if(!file)
+                return false;
+        }
+
+        std::remove(path.c_str());
+        return std::rename(temp.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 15) & ~uint64_t(15);
+    }
+};
@@ -0,0 +1,389 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include <unordered_map>
+
+//Обработка геометрии после загрузки, до того как она попадёт в пул
+class MeshOptimizer{
+public:
+    //Склеивает вершины с одинаковыми атрибутами; corners - по вершине на каждый угол треугольника,
+    //на выходе уникальные вершины и индексы в них
+    static void Weld(const std::vector<Vertex>& corners, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        std::unordered_map<VertexKey, uint32_t, VertexHash> lookup;
+        lookup.reserve(corners.size());
+
+        vertices.clear();
+        indices.clear();
+        indices.reserve(corners.size());
+
+        for(const auto& corner : corners)
+        {
+            auto it = lookup.find(VertexKey{&corner});
+            if(it != lookup.end())
+            {
+                indices.push_back(it->second);
+                continue;
+            }
+
+            uint32_t index = static_cast<uint32_t>(vertices.size());
+
+            //Ключ указывает на исходный угол, чтобы не зависеть от перевыделения vertices
+            lookup.emplace(VertexKey{&corner}, index);
+            vertices.push_back(corner);
+            indices.push_back(index);
+        }
+    }
+
+    //Порядок треугольников под кэш пост-трансформации (алгоритм Форсайта, LRU на CacheSize вершин)
+    static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+    {
+        size_t triCount = indices.size() / 3;
+        if(triCount == 0)
+            return;
+
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        for(uint32_t index : indices)
+            offsets[index + 1]++;
+        for(size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for(uint32_t t = 0; t < triCount; t++)
+            for(int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = t;
+
+        //Сколько ещё не выведенных треугольников у вершины
+        std::vector<uint32_t> remaining(vertexCount);
+        for(size_t v = 0; v < vertexCount; v++)
+            remaining[v] = offsets[v + 1] - offsets[v];
+
+        std::vector<int32_t> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        for(size_t v = 0; v < vertexCount; v++)
+            vertexScore[v] = forsythScore(-1, remaining[v]);
+
+        std::vector<float> triScore(triCount);
+        for(uint32_t t = 0; t < triCount; t++)
+            triScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+        std::vector<uint8_t> emitted(triCount, 0);
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+
+        std::vector<uint32_t> cache, nextCache, evicted;
+        cache.reserve(CacheSize + 3);
+        nextCache.reserve(CacheSize + 3);
+
+        uint32_t seed = 0;
+
+        while(result.size() < indices.size())
+        {
+            //Лучший треугольник среди вершин кэша, иначе первый не выведенный
+            uint32_t best = UINT32_MAX;
+            float bestScore = -1.0f;
+
+            for(uint32_t v : cache)
+            {
+                for(uint32_t a = offsets[v]; a < offsets[v + 1]; a++)
+                {
+                    uint32_t t = adjacency[a];
+                    if(!emitted[t] && triScore[t] > bestScore)
+                    {
+                        best = t;
+                        bestScore = triScore[t];
+                    }
+                }
+            }
+
+            if(best == UINT32_MAX)
+            {
+                while(emitted[seed])
+                    seed++;
+                best = seed;
+            }
+
+            emitted[best] = 1;
+
+            nextCache.clear();
+            for(int k = 0; k < 3; k++)
+            {
+                uint32_t v = indices[best * 3 + k];
+                result.push_back(v);
+                nextCache.push_back(v);
+                remaining[v]--;
+            }
+
+            for(uint32_t v : cache)
+                if(v != nextCache[0] && v != nextCache[1] && v != nextCache[2])
+                    nextCache.push_back(v);
+
+            //Вытесненные вершины теряют бонус кэша
+            evicted.clear();
+            for(size_t i = CacheSize; i < nextCache.size(); i++)
+            {
+                cachePosition[nextCache[i]] = -1;
+                evicted.push_back(nextCache[i]);
+            }
+
+            if(nextCache.size() > CacheSize)
+                nextCache.resize(CacheSize);
+
+            std::swap(cache, nextCache);
+
+            for(size_t i = 0; i < cache.size(); i++)
+                cachePosition[cache[i]] = static_cast<int32_t>(i);
+
+            //Пересчёт очков только для треугольников вокруг кэша и вытесненных вершин
+            for(uint32_t v : evicted)
+                updateScores(v, indices, offsets, adjacency, emitted, remaining, cachePosition, vertexScore, triScore);
+            for(uint32_t v : cache)
+                updateScores(v, indices, offsets, adjacency, emitted, remaining, cachePosition, vertexScore, triScore);
+        }
+
+        indices = result;
+    }
+
+    //Режет уже оптимизированный под кэш порядок на кластеры (Sander, Tipsify): кластер закрывается,
+    //как только его ACMR с холодным кэшем не хуже threshold * ACMR всего меша. Потом первыми
+    //выводятся кластеры, смотрящие наружу: они чаще закрывают остальные и меньше перерисовывают
+    static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f)
+    {
+        size_t triCount = indices.size() / 3;
+        if(triCount < 2)
+            return;
+
+        float before = ACMR(indices, vertices.size());
+
+        std::vector<uint32_t> clusterStarts;
+        std::vector<uint32_t> fifo(vertices.size(), 0);
+        uint32_t time = CacheSize + 1;
+        uint32_t clusterMisses = 0;
+
+        for(uint32_t t = 0; t < triCount; t++)
+        {
+            //Новый кластер начинается с пустого кэша
+            if(clusterStarts.empty() || clusterMisses == 0)
+            {
+                if(clusterStarts.empty() || clusterStarts.back() != t)
+                    clusterStarts.push_back(t);
+                time += CacheSize + 1;
+            }
+
+            for(int k = 0; k < 3; k++)
+            {
+                uint32_t v = indices[t * 3 + k];
+                if(time - fifo[v] > CacheSize)
+                {
+                    fifo[v] = time++;
+                    clusterMisses++;
+                }
+            }
+
+            uint32_t clusterTris = t + 1 - clusterStarts.back();
+            if(clusterTris >= MinOverdrawCluster && clusterMisses <= threshold * before * clusterTris)
+                clusterMisses = 0;
+        }
+
+        if(clusterStarts.size() < 2)
+            return;
+
+        glm::vec3 meshCenter(0.0f);
+        for(auto& vertex : vertices)
+            meshCenter += vertex.pos;
+        meshCenter /= static_cast<float>(std::max<size_t>(vertices.size(), 1));
+
+        struct Cluster{
+            uint32_t first;
+            uint32_t count;
+            float sortKey;
+        };
+
+        std::vector<Cluster> clusters;
+        clusters.reserve(clusterStarts.size());
+
+        for(size_t c = 0; c < clusterStarts.size(); c++)
+        {
+            uint32_t first = clusterStarts[c];
+            uint32_t last = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : static_cast<uint32_t>(triCount);
+
+            glm::vec3 centroid(0.0f), normal(0.0f);
+            float area = 0.0f;
+
+            for(uint32_t t = first; t < last; t++)
+            {
+                glm::vec3 p0 = vertices[indices[t * 3]].pos, p1 = vertices[indices[t * 3 + 1]].pos, p2 = vertices[indices[t * 3 + 2]].pos;
+                glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+                float a = glm::length(n);
+
+                centroid += (p0 + p1 + p2) * (a / 3.0f);
+                normal += n;
+                area += a;
+            }
+
+            float key = 0.0f;
+            if(area > 0.0f && glm::length(normal) > 0.0f)
+                key = glm::dot(centroid / area - meshCenter, glm::normalize(normal));
+
+            clusters.push_back({first, last - first, key});
+        }
+
+        std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b){
+            return a.sortKey > b.sortKey;
+        });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for(auto& cluster : clusters)
+            result.insert(result.end(), indices.begin() + cluster.first * 3, indices.begin() + (cluster.first + cluster.count) * 3);
+
+        if(ACMR(result, vertices.size()) <= before * threshold)
+            indices = result;
+    }
+
+    //Вершины в порядке первого обращения, чтобы выборка шла по памяти подряд
+    static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+        std::vector<Vertex> result;
+        result.reserve(vertices.size());
+
+        for(uint32_t& index : indices)
+        {
+            if(remap[index] == UINT32_MAX)
+            {
+                remap[index] = static_cast<uint32_t>(result.size());
+                result.push_back(vertices[index]);
+            }
+
+            index = remap[index];
+        }
+
+        vertices = result;
+    }
+
+    //Среднее число промахов кэша (FIFO на CacheSize вершин) на треугольник
+    static float ACMR(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = CacheSize)
+    {
+        if(indices.size() < 3)
+            return 0.0f;
+
+        return static_cast<float>(countMisses(indices, vertexCount, cacheSize)) / (indices.size() / 3);
+    }
+
+    //Промахи на одну уникальную вершину, 1.0 - идеал
+    static float ATVR(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = CacheSize)
+    {
+        std::vector<uint8_t> used(vertexCount, 0);
+        size_t unique = 0;
+        for(uint32_t index : indices)
+        {
+            if(!used[index])
+            {
+                used[index] = 1;
+                unique++;
+            }
+        }
+
+        if(unique == 0)
+            return 0.0f;
+
+        return static_cast<float>(countMisses(indices, vertexCount, cacheSize)) / unique;
+    }
+
+    inline static const uint32_t CacheSize = 16;
+    inline static const uint32_t MinOverdrawCluster = 64;
+
+    //16-битных индексов хватает, пока вершин не больше 65536
+    static VkIndexType IndexTypeFor(size_t vertexCount)
+    {
+        return vertexCount <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    }
+
+private:
+    static float forsythScore(int32_t position, uint32_t remaining)
+    {
+        if(remaining == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+
+        if(position >= 0)
+        {
+            //Вершины только что выведенного треугольника не поощряем сильнее остальных
+            if(position < 3)
+                score = 0.75f;
+            else
+                score = std::pow(1.0f - (position - 3) / float(CacheSize - 3), 1.5f);
+        }
+
+        //Бонус вершинам, у которых осталось мало треугольников
+        score += 2.0f / std::sqrt(static_cast<float>(remaining));
+
+        return score;
+    }
+
+    static void updateScores(uint32_t v, const std::vector<uint32_t>& indices, const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& adjacency,
+                             const std::vector<uint8_t>& emitted, const std::vector<uint32_t>& remaining, const std::vector<int32_t>& cachePosition,
+                             std::vector<float>& vertexScore, std::vector<float>& triScore)
+    {
+        float score = forsythScore(cachePosition[v], remaining[v]);
+        if(score == vertexScore[v])
+            return;
+
+        vertexScore[v] = score;
+
+        for(uint32_t a = offsets[v]; a < offsets[v + 1]; a++)
+        {
+            uint32_t t = adjacency[a];
+            if(!emitted[t])
+                triScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        }
+    }
+
+    static size_t countMisses(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+    {
+        std::vector<uint32_t> stamp(vertexCount, 0);
+        uint32_t time = cacheSize + 1;
+        size_t misses = 0;
+
+        for(uint32_t index : indices)
+        {
+            if(time - stamp[index] > cacheSize)
+            {
+                stamp[index] = time++;
+                misses++;
+            }
+        }
+
+        return misses;
+    }
+
+    struct VertexKey{
+        const Vertex* vertex;
+
+        bool operator==(const VertexKey& other) const
+        {
+            return memcmp(vertex, other.vertex, sizeof(Vertex)) == 0;
+        }
+    };
+
+    //FNV-1a по байтам вершины
+    struct VertexHash{
+        size_t operator()(const VertexKey& key) const
+        {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(key.vertex);
+
+            uint64_t hash = 14695981039346656037ull;
+            for(size_t i = 0; i < sizeof(Vertex); i++)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+
+            return static_cast<size_t>(hash);
+        }
+    };
+};
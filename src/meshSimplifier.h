@@ -0,0 +1,341 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include <unordered_map>
+#include <cfloat>
+
+//Упрощение по квадрикам ошибки (Garland-Heckbert): стягиваем рёбра в один из концов,
+//так атрибуты вершин остаются как есть и буфер вершин общий для всех LOD
+class MeshSimplifier{
+public:
+    static std::vector<uint32_t> Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float* resultError = nullptr)
+    {
+        std::vector<uint32_t> remap, canonical;
+        weldPositions(vertices, remap, canonical);
+
+        size_t repCount = canonical.size();
+
+        std::vector<uint32_t> tris = indices;
+
+        std::vector<uint8_t> locked(repCount, 0), seams(repCount, 0);
+        lockSeams(vertices, remap, canonical, seams);
+        locked = seams;
+        lockBorders(tris, remap, locked);
+
+        std::vector<Quadric> quadrics(repCount);
+        for(size_t t = 0; t + 2 < tris.size(); t += 3)
+        {
+            uint32_t a = remap[tris[t]], b = remap[tris[t + 1]], c = remap[tris[t + 2]];
+
+            Quadric q = Quadric::FromTriangle(vertices[canonical[a]].pos, vertices[canonical[b]].pos, vertices[canonical[c]].pos);
+
+            quadrics[a] += q;
+            quadrics[b] += q;
+            quadrics[c] += q;
+        }
+
+        std::vector<uint32_t> collapseTo(repCount);
+        for(uint32_t r = 0; r < repCount; r++)
+            collapseTo[r] = r;
+
+        float maxError = 0.0f;
+
+        while(tris.size() > targetIndexCount)
+        {
+            std::vector<Collapse> collapses = pickCollapses(vertices, tris, remap, canonical, locked, seams, quadrics);
+            if(collapses.empty())
+                break;
+
+            std::vector<std::vector<uint32_t>> adjacency(repCount);
+            for(uint32_t t = 0; t + 2 < tris.size(); t += 3)
+            {
+                adjacency[remap[tris[t]]].push_back(t);
+                adjacency[remap[tris[t + 1]]].push_back(t);
+                adjacency[remap[tris[t + 2]]].push_back(t);
+            }
+
+            std::vector<uint8_t> touched(repCount, 0);
+
+            size_t removed = 0;
+            size_t budget = (tris.size() - targetIndexCount) / 3;
+            bool collapsedAny = false;
+
+            for(auto& collapse : collapses)
+            {
+                if(removed >= budget)
+                    break;
+
+                if(touched[collapse.from] || touched[collapse.to])
+                    continue;
+
+                if(flips(vertices, tris, remap, canonical, adjacency[collapse.from], collapse.from, collapse.to))
+                    continue;
+
+                for(uint32_t t : adjacency[collapse.from])
+                {
+                    uint32_t a = remap[tris[t]], b = remap[tris[t + 1]], c = remap[tris[t + 2]];
+
+                    touched[a] = touched[b] = touched[c] = 1;
+
+                    if(a == collapse.to || b == collapse.to || c == collapse.to)
+                        removed++;
+                }
+
+                collapseTo[collapse.from] = collapse.to;
+                quadrics[collapse.to] += quadrics[collapse.from];
+                maxError = std::max(maxError, collapse.error);
+                collapsedAny = true;
+            }
+
+            if(!collapsedAny)
+                break;
+
+            //Переписываем индексы и выкидываем вырожденные треугольники
+            size_t write = 0;
+            for(size_t t = 0; t + 2 < tris.size(); t += 3)
+            {
+                uint32_t tri[3];
+                for(int k = 0; k < 3; k++)
+                {
+                    uint32_t rep = remap[tris[t + k]];
+                    tri[k] = rep != collapseTo[rep] ? canonical[collapseTo[rep]] : tris[t + k];
+                }
+
+                if(remap[tri[0]] == remap[tri[1]] || remap[tri[1]] == remap[tri[2]] || remap[tri[0]] == remap[tri[2]])
+                    continue;
+
+                tris[write++] = tri[0];
+                tris[write++] = tri[1];
+                tris[write++] = tri[2];
+            }
+            tris.resize(write);
+
+            for(uint32_t r = 0; r < repCount; r++)
+                collapseTo[r] = r;
+        }
+
+        if(resultError)
+            *resultError = maxError;
+
+        return tris;
+    }
+
+private:
+    struct Quadric{
+        double a2 = 0, ab = 0, ac = 0, ad = 0;
+        double b2 = 0, bc = 0, bd = 0;
+        double c2 = 0, cd = 0;
+        double d2 = 0;
+        double weight = 0;
+
+        static Quadric FromTriangle(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2)
+        {
+            Quadric q;
+
+            glm::dvec3 normal = glm::cross(glm::dvec3(p1 - p0), glm::dvec3(p2 - p0));
+            double area = glm::length(normal);
+
+            if(area <= 0.0)
+                return q;
+
+            normal /= area;
+            double d = -glm::dot(normal, glm::dvec3(p0));
+
+            //Вес по площади, чтобы мелкие треугольники не перетягивали
+            q.a2 = normal.x * normal.x * area; q.ab = normal.x * normal.y * area; q.ac = normal.x * normal.z * area; q.ad = normal.x * d * area;
+            q.b2 = normal.y * normal.y * area; q.bc = normal.y * normal.z * area; q.bd = normal.y * d * area;
+            q.c2 = normal.z * normal.z * area; q.cd = normal.z * d * area;
+            q.d2 = d * d * area;
+            q.weight = area;
+
+            return q;
+        }
+
+        Quadric& operator+=(const Quadric& o)
+        {
+            a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+            b2 += o.b2; bc += o.bc; bd += o.bd;
+            c2 += o.c2; cd += o.cd;
+            d2 += o.d2;
+            weight += o.weight;
+            return *this;
+        }
+
+        double Eval(glm::vec3 p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double r = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                     + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                     + c2 * z * z + 2 * cd * z
+                     + d2;
+            return std::max(r, 0.0);
+        }
+
+        //Среднеквадратичное расстояние до плоскостей, в единицах меша
+        float Distance(glm::vec3 p) const
+        {
+            return weight > 0.0 ? (float)std::sqrt(Eval(p) / weight) : 0.0f;
+        }
+    };
+
+    struct Collapse{
+        uint32_t from;
+        uint32_t to;
+        float error;
+    };
+
+    struct PositionHash{
+        size_t operator()(const glm::vec3& p) const
+        {
+            uint32_t h[3];
+            memcpy(h, &p, sizeof(h));
+            return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+        }
+    };
+
+    static void weldPositions(const std::vector<Vertex>& vertices, std::vector<uint32_t>& remap, std::vector<uint32_t>& canonical)
+    {
+        std::unordered_map<glm::vec3, uint32_t, PositionHash> lookup;
+        lookup.reserve(vertices.size());
+
+        remap.resize(vertices.size());
+        canonical.clear();
+
+        for(uint32_t i = 0; i < vertices.size(); i++)
+        {
+            auto it = lookup.find(vertices[i].pos);
+            if(it != lookup.end())
+            {
+                remap[i] = it->second;
+                continue;
+            }
+
+            uint32_t rep = static_cast<uint32_t>(canonical.size());
+            lookup.emplace(vertices[i].pos, rep);
+            canonical.push_back(i);
+            remap[i] = rep;
+        }
+    }
+
+    //Шов по UV: у позиции несколько вершин с разными UV, стягивание такой вершины порвёт развёртку
+    static void lockSeams(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& remap, const std::vector<uint32_t>& canonical, std::vector<uint8_t>& seams)
+    {
+        for(uint32_t i = 0; i < vertices.size(); i++)
+        {
+            uint32_t rep = remap[i];
+            if(vertices[canonical[rep]].texCoord != vertices[i].texCoord)
+                seams[rep] = 1;
+        }
+    }
+
+    //Граничные рёбра не трогаем: иначе появятся щели между соседними чанками
+    static void lockBorders(const std::vector<uint32_t>& tris, const std::vector<uint32_t>& remap, std::vector<uint8_t>& locked)
+    {
+        std::unordered_map<uint64_t, uint32_t> edges;
+        edges.reserve(tris.size());
+
+        for(size_t t = 0; t + 2 < tris.size(); t += 3)
+        {
+            for(int k = 0; k < 3; k++)
+            {
+                uint32_t a = remap[tris[t + k]], b = remap[tris[t + (k + 1) % 3]];
+                edges[edgeKey(a, b)]++;
+            }
+        }
+
+        for(auto& edge : edges)
+        {
+            if(edge.second == 1)
+            {
+                locked[edge.first >> 32] = 1;
+                locked[edge.first & 0xFFFFFFFF] = 1;
+            }
+        }
+    }
+
+    static uint64_t edgeKey(uint32_t a, uint32_t b)
+    {
+        if(a > b)
+            std::swap(a, b);
+        return ((uint64_t)a << 32) | b;
+    }
+
+    static std::vector<Collapse> pickCollapses(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& tris, const std::vector<uint32_t>& remap, const std::vector<uint32_t>& canonical, const std::vector<uint8_t>& locked, const std::vector<uint8_t>& seams, const std::vector<Quadric>& quadrics)
+    {
+        std::vector<uint64_t> edges;
+        edges.reserve(tris.size());
+
+        for(size_t t = 0; t + 2 < tris.size(); t += 3)
+        {
+            for(int k = 0; k < 3; k++)
+            {
+                uint32_t a = remap[tris[t + k]], b = remap[tris[t + (k + 1) % 3]];
+                edges.push_back(edgeKey(a, b));
+            }
+        }
+
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        std::vector<Collapse> collapses;
+        collapses.reserve(edges.size());
+
+        for(uint64_t edge : edges)
+        {
+            uint32_t a = (uint32_t)(edge >> 32), b = (uint32_t)(edge & 0xFFFFFFFF);
+
+            Quadric q = quadrics[a];
+            q += quadrics[b];
+
+            glm::vec3 pa = vertices[canonical[a]].pos, pb = vertices[canonical[b]].pos;
+
+            //На шов тоже не стягиваем: треугольники получили бы одну из копий вершины шва
+            //с UV другой стороны. Вершины шва сами заблокированы, так что стянуть вдоль того же шва нечего
+            float costAB = locked[a] || seams[b] ? FLT_MAX : q.Distance(pb);
+            float costBA = locked[b] || seams[a] ? FLT_MAX : q.Distance(pa);
+
+            if(costAB == FLT_MAX && costBA == FLT_MAX)
+                continue;
+
+            if(costAB <= costBA)
+                collapses.push_back({a, b, costAB});
+            else
+                collapses.push_back({b, a, costBA});
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y){
+            return x.error < y.error;
+        });
+
+        return collapses;
+    }
+
+    static bool flips(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& tris, const std::vector<uint32_t>& remap, const std::vector<uint32_t>& canonical, const std::vector<uint32_t>& around, uint32_t from, uint32_t to)
+    {
+        glm::vec3 target = vertices[canonical[to]].pos;
+
+        for(uint32_t t : around)
+        {
+            uint32_t r[3] = {remap[tris[t]], remap[tris[t + 1]], remap[tris[t + 2]]};
+
+            if(r[0] == to || r[1] == to || r[2] == to)
+                continue;
+
+            glm::vec3 p[3], q[3];
+            for(int k = 0; k < 3; k++)
+            {
+                p[k] = vertices[canonical[r[k]]].pos;
+                q[k] = r[k] == from ? target : p[k];
+            }
+
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+
+            if(glm::dot(before, after) <= 0.0f)
+                return true;
+        }
+
+        return false;
+    }
+};
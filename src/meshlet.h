@@ -0,0 +1,186 @@
+#pragma once
+
+#include "stdinclude.h"
+
+//Кластер треугольников: непрерывный диапазон индексов LOD0 плюс границы для отсечения.
+//Раскладка совпадает со struct Cluster в shaders/meshletCull.comp (std430)
+struct Meshlet{
+    glm::vec4 sphere;    // xyz - центр, w - радиус
+    glm::vec4 cone;      // xyz - ось, w - cutoff (1 - не отсекать по конусу)
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    uint32_t object;
+};
+
+class MeshletBuilder{
+public:
+    inline static const uint32_t MaxVertices = 64;
+    inline static const uint32_t MaxTriangles = 124;
+
+    //Переупорядочивает треугольники диапазона так, что каждый мешлет лежит подряд
+    static std::vector<Meshlet> Build(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        std::vector<Meshlet> meshlets;
+
+        uint32_t triCount = static_cast<uint32_t>(indices.size() / 3);
+        if(triCount == 0)
+            return meshlets;
+
+        //Треугольники каждой вершины в CSR-виде
+        std::vector<uint32_t> offsets(vertices.size() + 1, 0);
+        for(uint32_t index : indices)
+            offsets[index + 1]++;
+        for(size_t v = 0; v < vertices.size(); v++)
+            offsets[v + 1] += offsets[v];
+
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for(uint32_t t = 0; t < triCount; t++)
+            for(int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = t;
+
+        std::vector<uint8_t> emitted(triCount, 0);
+        std::vector<uint32_t> stamp(vertices.size(), UINT32_MAX);
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+
+        std::vector<uint32_t> meshletVertices;
+        uint32_t meshletTris = 0;
+        uint32_t seed = 0;
+
+        auto newVertices = [&](uint32_t t, uint32_t id){
+            uint32_t count = 0;
+            for(int k = 0; k < 3; k++)
+                if(stamp[indices[t * 3 + k]] != id)
+                    count++;
+            return count;
+        };
+
+        auto closeMeshlet = [&](){
+            if(meshletTris == 0)
+                return;
+
+            Meshlet meshlet{};
+            meshlet.indexCount = meshletTris * 3;
+            meshlet.firstIndex = static_cast<uint32_t>(result.size() - meshlet.indexCount);
+            computeBounds(vertices, result.data() + meshlet.firstIndex, meshletTris, meshletVertices, meshlet);
+
+            meshlets.push_back(meshlet);
+            meshletVertices.clear();
+            meshletTris = 0;
+        };
+
+        while(true)
+        {
+            uint32_t id = static_cast<uint32_t>(meshlets.size());
+
+            //Лучший кандидат среди соседей: больше общих вершин - меньше новых
+            uint32_t best = UINT32_MAX, bestNew = 4;
+            for(uint32_t v : meshletVertices)
+            {
+                for(uint32_t a = offsets[v]; a < offsets[v + 1]; a++)
+                {
+                    uint32_t t = adjacency[a];
+                    if(emitted[t])
+                        continue;
+
+                    uint32_t added = newVertices(t, id);
+                    if(added < bestNew)
+                    {
+                        best = t;
+                        bestNew = added;
+                    }
+                }
+            }
+
+            if(best == UINT32_MAX)
+            {
+                while(seed < triCount && emitted[seed])
+                    seed++;
+
+                if(seed == triCount)
+                    break;
+
+                best = seed;
+                bestNew = newVertices(best, id);
+            }
+
+            if(meshletVertices.size() + bestNew > MaxVertices || meshletTris + 1 > MaxTriangles)
+            {
+                closeMeshlet();
+                continue;
+            }
+
+            for(int k = 0; k < 3; k++)
+            {
+                uint32_t v = indices[best * 3 + k];
+                if(stamp[v] != id)
+                {
+                    stamp[v] = id;
+                    meshletVertices.push_back(v);
+                }
+                result.push_back(v);
+            }
+
+            emitted[best] = 1;
+            meshletTris++;
+        }
+
+        closeMeshlet();
+
+        indices = result;
+        return meshlets;
+    }
+
+private:
+    static void computeBounds(const std::vector<Vertex>& vertices, const uint32_t* tris, uint32_t triCount, const std::vector<uint32_t>& meshletVertices, Meshlet& meshlet)
+    {
+        glm::vec3 min = vertices[meshletVertices[0]].pos, max = min;
+        for(uint32_t v : meshletVertices)
+        {
+            min = glm::min(min, vertices[v].pos);
+            max = glm::max(max, vertices[v].pos);
+        }
+
+        glm::vec3 center = (min + max) * 0.5f;
+        float radius = 0.0f;
+        for(uint32_t v : meshletVertices)
+            radius = std::max(radius, glm::length(vertices[v].pos - center));
+
+        meshlet.sphere = glm::vec4(center, radius);
+
+        std::vector<glm::vec3> normals;
+        glm::vec3 axis(0.0f);
+        for(uint32_t t = 0; t < triCount; t++)
+        {
+            glm::vec3 p0 = vertices[tris[t * 3]].pos, p1 = vertices[tris[t * 3 + 1]].pos, p2 = vertices[tris[t * 3 + 2]].pos;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(normal);
+
+            if(length <= 0.0f)
+                continue;
+
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+
+        meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+        if(normals.empty() || glm::length(axis) <= 0.0f)
+            return;
+
+        axis = glm::normalize(axis);
+
+        float minDot = 1.0f;
+        for(auto& normal : normals)
+            minDot = std::min(minDot, glm::dot(axis, normal));
+
+        //Слишком широкий конус всё равно ничего не отсечёт
+        if(minDot <= 0.1f)
+            return;
+
+        meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+    }
+};
@@ -0,0 +1,417 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "device.h"
+#include "tools.h"
+#include "resource.h"
+#include "renderer.h"
+#include "meshlet.h"
+
+struct MeshletObject{
+    glm::mat4 world;
+    glm::vec4 params;
+};
+
+struct MeshletPushConstants{
+    glm::vec4 planes[6];
+    glm::vec4 cameraPos;
+    uint32_t clusterCount;
+};
+
+//Отсечение кластеров по пирамиде видимости и конусу нормалей. Каждый кластер получает
+//свою команду VkDrawIndexedIndirectCommand, отсечённые - с instanceCount = 0.
+//Если shaders/meshletCull.spv нет, те же команды пишет CPU
+class MeshletRenderer{
+public:
+    MeshletRenderer(Device* device)
+    {
+        this->device = device;
+
+        frames.resize(Resource::countFrames);
+
+        createComputePipeline();
+    }
+    ~MeshletRenderer()
+    {
+        for(auto& frame : frames)
+            destroyFrame(frame);
+
+        if(gpuCulling)
+        {
+            vkDestroyPipeline(device->device, pipeline, nullptr);
+            vkDestroyPipelineLayout(device->device, pipelineLayout, nullptr);
+            vkDestroyDescriptorPool(device->device, descriptorPool, nullptr);
+            vkDestroyDescriptorSetLayout(device->device, descriptorSetLayout, nullptr);
+        }
+    }
+
+    //Правка shaders/meshletCull.spv: старый пайплайн удаляется, когда его не читает ни один кадр,
+    //при ошибке остаётся прежний. Если шейдера не было при запуске, отсечение остаётся на CPU
+    bool ReloadShader(const std::string& path)
+    {
+        if(!gpuCulling || AssetPack::NormalizePath(path) != ShaderPath)
+            return false;
+
+        try{
+            std::vector<char> code = Renderer::readFile(ShaderPath);
+            if(!Renderer::isSpirv(code))
+                throw std::runtime_error("invalid SPIR-V!");
+
+            VkPipeline old = pipeline;
+            pipeline = createPipeline(code);
+
+            Device* device = this->device;
+            DeletionQueue::Push([device, old]{ vkDestroyPipeline(device->device, old, nullptr); });
+        }catch(const std::exception& e){
+            std::cerr << "failed to rebuild pipeline " << ShaderPath << ": " << e.what() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    void BeginFrame()
+    {
+        clusters.clear();
+        objects.clear();
+    }
+
+    //Возвращает номер первой команды объекта в буфере команд этого кадра
+    uint32_t AddObject(const glm::mat4& world, bool counterClockwise, const std::vector<Meshlet>& meshlets, uint32_t firstIndex, int32_t vertexOffset)
+    {
+        uint32_t object = static_cast<uint32_t>(objects.size());
+        uint32_t first = static_cast<uint32_t>(clusters.size());
+
+        objects.push_back({world, glm::vec4(counterClockwise ? 1.0f : -1.0f, 0.0f, 0.0f, 0.0f)});
+
+        for(auto meshlet : meshlets)
+        {
+            meshlet.firstIndex += firstIndex;
+            meshlet.vertexOffset = vertexOffset;
+            meshlet.object = object;
+            clusters.push_back(meshlet);
+        }
+
+        return first;
+    }
+
+    void Upload(const std::array<glm::vec4, 6>& planes, glm::vec3 cameraPos)
+    {
+        Frame& frame = frames[Resource::currentImage];
+
+        reserve(frame, static_cast<uint32_t>(clusters.size()), static_cast<uint32_t>(objects.size()));
+
+        push.cameraPos = glm::vec4(cameraPos, 1.0f);
+        push.clusterCount = static_cast<uint32_t>(clusters.size());
+        for(int i = 0; i < 6; i++)
+            push.planes[i] = planes[i];
+
+        if(clusters.empty())
+            return;
+
+        if(!gpuCulling)
+        {
+            cullOnCpu(frame);
+            return;
+        }
+
+        write(frame.clusterMemory, clusters.data(), clusters.size() * sizeof(Meshlet));
+        write(frame.objectMemory, objects.data(), objects.size() * sizeof(MeshletObject));
+    }
+
+    //Вызывается вне render pass, до отрисовки
+    void Dispatch(VkCommandBuffer commandBuffer)
+    {
+        if(!gpuCulling || clusters.empty())
+            return;
+
+        Frame& frame = frames[Resource::currentImage];
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MeshletPushConstants), &push);
+        vkCmdDispatch(commandBuffer, (push.clusterCount + 63) / 64, 1, 1);
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = frame.commandBuffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    void Draw(VkCommandBuffer commandBuffer, uint32_t firstCommand, uint32_t commandCount)
+    {
+        Frame& frame = frames[Resource::currentImage];
+        VkDeviceSize offset = firstCommand * sizeof(VkDrawIndexedIndirectCommand);
+
+        if(device->multiDrawIndirect)
+        {
+            vkCmdDrawIndexedIndirect(commandBuffer, frame.commandBuffer, offset, commandCount, sizeof(VkDrawIndexedIndirectCommand));
+            return;
+        }
+
+        for(uint32_t i = 0; i < commandCount; i++)
+            vkCmdDrawIndexedIndirect(commandBuffer, frame.commandBuffer, offset + i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+    }
+
+    bool gpuCulling = false;
+
+    inline static const char* ShaderPath = "shaders/meshletCull.spv";
+
+    uint32_t clustersVisible = 0;
+
+private:
+    struct Frame{
+        uint32_t clusterCapacity = 0;
+        uint32_t objectCapacity = 0;
+
+        VkBuffer clusterBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory clusterMemory;
+        VkBuffer objectBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory objectMemory;
+        VkBuffer commandBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory commandMemory;
+
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+
+    void createComputePipeline()
+    {
+        std::vector<char> code;
+        try {
+            code = Renderer::readFile(ShaderPath);
+        } catch (const std::exception&) {
+            return;
+        }
+
+        std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+        for(uint32_t i = 0; i < bindings.size(); i++)
+        {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(device->device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = static_cast<uint32_t>(3 * Resource::countFrames);
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = static_cast<uint32_t>(Resource::countFrames);
+
+        if (vkCreateDescriptorPool(device->device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+
+        std::vector<VkDescriptorSetLayout> layouts(Resource::countFrames, descriptorSetLayout);
+        std::vector<VkDescriptorSet> sets(Resource::countFrames);
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(Resource::countFrames);
+        allocInfo.pSetLayouts = layouts.data();
+
+        if (vkAllocateDescriptorSets(device->device, &allocInfo, sets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+
+        for(size_t i = 0; i < frames.size(); i++)
+            frames[i].descriptorSet = sets[i];
+
+        VkPushConstantRange pushRange{};
+        pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushRange.offset = 0;
+        pushRange.size = sizeof(MeshletPushConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+        if (vkCreatePipelineLayout(device->device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+
+        pipeline = createPipeline(code);
+
+        gpuCulling = true;
+    }
+
+    //Раскладка общая, от шейдера зависит только сам пайплайн
+    VkPipeline createPipeline(const std::vector<char>& code)
+    {
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = code.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+        VkShaderModule shaderModule;
+        if (vkCreateShaderModule(device->device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shader module!");
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = shaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+
+        VkPipeline computePipeline;
+        VkResult result = vkCreateComputePipelines(device->device, Renderer::pipelineCache, 1, &pipelineInfo, nullptr, &computePipeline);
+
+        vkDestroyShaderModule(device->device, shaderModule, nullptr);
+
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+
+        return computePipeline;
+    }
+
+    void reserve(Frame& frame, uint32_t clusterCount, uint32_t objectCount)
+    {
+        if(clusterCount <= frame.clusterCapacity && objectCount <= frame.objectCapacity)
+            return;
+
+        destroyFrame(frame);
+
+        frame.clusterCapacity = std::max<uint32_t>(256, clusterCount * 2);
+        frame.objectCapacity = std::max<uint32_t>(16, objectCount * 2);
+
+        VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+        Tools::createBuffer(frame.clusterCapacity * sizeof(Meshlet), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, frame.clusterBuffer, frame.clusterMemory);
+        Tools::createBuffer(frame.objectCapacity * sizeof(MeshletObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, frame.objectBuffer, frame.objectMemory);
+
+        //Без компьютного шейдера команды пишет CPU, значит буфер должен быть видим хосту
+        VkMemoryPropertyFlags commandProperties = gpuCulling ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : hostVisible;
+        Tools::createBuffer(frame.clusterCapacity * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, commandProperties, frame.commandBuffer, frame.commandMemory);
+
+        if(!gpuCulling)
+            return;
+
+        VkDescriptorBufferInfo bufferInfos[3] = {
+            {frame.clusterBuffer, 0, VK_WHOLE_SIZE},
+            {frame.objectBuffer, 0, VK_WHOLE_SIZE},
+            {frame.commandBuffer, 0, VK_WHOLE_SIZE}
+        };
+
+        std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+        for(uint32_t i = 0; i < descriptorWrites.size(); i++)
+        {
+            descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[i].dstSet = frame.descriptorSet;
+            descriptorWrites[i].dstBinding = i;
+            descriptorWrites[i].dstArrayElement = 0;
+            descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[i].descriptorCount = 1;
+            descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+        }
+
+        vkUpdateDescriptorSets(device->device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    void destroyFrame(Frame& frame)
+    {
+        if(frame.clusterBuffer == VK_NULL_HANDLE)
+            return;
+
+        vkDestroyBuffer(device->device, frame.clusterBuffer, nullptr);
+        vkFreeMemory(device->device, frame.clusterMemory, nullptr);
+        vkDestroyBuffer(device->device, frame.objectBuffer, nullptr);
+        vkFreeMemory(device->device, frame.objectMemory, nullptr);
+        vkDestroyBuffer(device->device, frame.commandBuffer, nullptr);
+        vkFreeMemory(device->device, frame.commandMemory, nullptr);
+
+        frame.clusterBuffer = VK_NULL_HANDLE;
+    }
+
+    void write(VkDeviceMemory memory, const void* source, size_t size)
+    {
+        void* data;
+        vkMapMemory(device->device, memory, 0, size, 0, &data);
+            memcpy(data, source, size);
+        vkUnmapMemory(device->device, memory);
+    }
+
+    //То же, что делает meshletCull.comp
+    void cullOnCpu(Frame& frame)
+    {
+        void* data;
+        vkMapMemory(device->device, frame.commandMemory, 0, clusters.size() * sizeof(VkDrawIndexedIndirectCommand), 0, &data);
+        VkDrawIndexedIndirectCommand* commands = static_cast<VkDrawIndexedIndirectCommand*>(data);
+
+        clustersVisible = 0;
+
+        for(size_t i = 0; i < clusters.size(); i++)
+        {
+            const Meshlet& cluster = clusters[i];
+            const MeshletObject& object = objects[cluster.object];
+
+            glm::vec3 center = glm::vec3(object.world * glm::vec4(glm::vec3(cluster.sphere), 1.0f));
+            float scale = std::max(glm::length(glm::vec3(object.world[0])), std::max(glm::length(glm::vec3(object.world[1])), glm::length(glm::vec3(object.world[2]))));
+            float radius = cluster.sphere.w * scale;
+
+            bool visible = true;
+            for(int p = 0; p < 6 && visible; p++)
+                visible = glm::dot(glm::vec3(push.planes[p]), center) + push.planes[p].w >= -radius;
+
+            if(visible && cluster.cone.w < 1.0f)
+            {
+                glm::vec3 axis = glm::normalize(glm::mat3(object.world) * glm::vec3(cluster.cone)) * object.params.x;
+                glm::vec3 view = center - glm::vec3(push.cameraPos);
+                visible = glm::dot(view, axis) < cluster.cone.w * glm::length(view) + radius;
+            }
+
+            commands[i].indexCount = cluster.indexCount;
+            commands[i].instanceCount = visible ? 1 : 0;
+            commands[i].firstIndex = cluster.firstIndex;
+            commands[i].vertexOffset = cluster.vertexOffset;
+            commands[i].firstInstance = 0;
+
+            if(visible)
+                clustersVisible++;
+        }
+
+        vkUnmapMemory(device->device, frame.commandMemory);
+    }
+
+    std::vector<Meshlet> clusters;
+    std::vector<MeshletObject> objects;
+
+    MeshletPushConstants push;
+
+    std::vector<Frame> frames;
+
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+
+    Device* device;
+};
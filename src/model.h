@@ -4,6 +4,27 @@
 
 #include "device.h"
 #include "tools.h"
+#include "geometryPool.h"
+#include "meshSimplifier.h"
+#include "meshlet.h"
+#include "meshOptimizer.h"
+#include "vertexLayout.h"
+#include "mappedFile.h"
+#include "deletionQueue.h"
+
+#include <memory>
+
+struct ModelLod{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+};
+
+struct MeshStats{
+    float acmrBefore = 0.0f;
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
 
 class Model{
 public:
@@ -13,82 +34,287 @@ public:
     }
     ~Model()
     {
-        if(indices.size() > 0)
+        if(uploaded)
+            pool->Free(geometry);
+    }
+    void Init()
+    {
+        if(uploaded)
+            pool->Free(geometry);
+        uploaded = false;
+
+        //Геометрия ещё не загружена (например, грузится в фоне) - рисовать нечего
+        if(vertices.empty() && !cacheFile)
+            return;
+
+        //Кэш хранит вершины в полной раскладке; под другую раскладку их придётся перекодировать
+        if(cacheFile && layout != VertexLayout::Full())
+            unpackCache();
+
+        if(cacheFile)
+        {
+            dequantize = glm::mat4(1.0f);
+
+            VertexStreams streams{{sizeof(Vertex)}, {cachedVertices}};
+            geometry = pool->Allocate(streams, cachedVertexCount, cachedIndices, cachedIndexCount, indexType);
+
+            uploaded = true;
+            return;
+        }
+
+        if(lods.empty())
+            Optimize();
+
+        ComputeBounds();
+
+        indexType = MeshOptimizer::IndexTypeFor(vertices.size());
+
+        dequantize = layout.GetDequantization(boundsMin, boundsMax);
+
+        std::vector<std::vector<uint8_t>> encoded = layout.Encode(vertices, boundsMin, boundsMax);
+        uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+        VertexStreams streams;
+        streams.strides = layout.GetStreamStrides();
+        for(auto& stream : encoded)
+            streams.data.push_back(stream.data());
+
+        if(indexType == VK_INDEX_TYPE_UINT16)
         {
-            vkDestroyBuffer(device->device, indexBuffer, nullptr);
-            vkFreeMemory(device->device, indexBufferMemory, nullptr);
+            std::vector<uint16_t> packed(indices.begin(), indices.end());
+            geometry = pool->Allocate(streams, vertexCount, packed.data(), static_cast<uint32_t>(packed.size()), indexType);
         }
-        
-        if(vertices.size() > 0)
+        else
+            geometry = pool->Allocate(streams, vertexCount, indices.data(), static_cast<uint32_t>(indices.size()), indexType);
+
+        uploaded = true;
+    }
+
+    //AABB и описанная сфера в координатах меша
+    void ComputeBounds()
+    {
+        boundsMin = boundsMax = glm::vec3(0.0f);
+        boundsCenter = glm::vec3(0.0f);
+        boundsRadius = 0.0f;
+
+        if(vertices.empty())
+            return;
+
+        boundsMin = boundsMax = vertices[0].pos;
+        for(auto& vertex : vertices)
         {
-            vkDestroyBuffer(device->device, vertexBuffer, nullptr);
-            vkFreeMemory(device->device, vertexBufferMemory, nullptr);
+            boundsMin = glm::min(boundsMin, vertex.pos);
+            boundsMax = glm::max(boundsMax, vertex.pos);
         }
+
+        boundsCenter = (boundsMin + boundsMax) * 0.5f;
+        for(auto& vertex : vertices)
+            boundsRadius = std::max(boundsRadius, glm::length(vertex.pos - boundsCenter));
     }
-    void Init()
+
+    //Забирает CPU-данные у другой модели, например собранной в рабочем потоке; загрузка - через Init
+    void TakeGeometry(Model& source)
+    {
+        vertices = std::move(source.vertices);
+        indices = std::move(source.indices);
+        indexType = source.indexType;
+        lods = std::move(source.lods);
+        meshlets = std::move(source.meshlets);
+        stats = source.stats;
+
+        boundsMin = source.boundsMin;
+        boundsMax = source.boundsMax;
+        boundsCenter = source.boundsCenter;
+        boundsRadius = source.boundsRadius;
+
+        cacheFile = std::move(source.cacheFile);
+        cachedVertices = source.cachedVertices;
+        cachedIndices = source.cachedIndices;
+        cachedVertexCount = source.cachedVertexCount;
+        cachedIndexCount = source.cachedIndexCount;
+
+        source.ResetCache();
+    }
+
+    //Подмена геометрии у модели, на которую уже ссылаются сущности (горячая перезагрузка):
+    //старый участок пула освобождается, когда его не читает ни один кадр
+    void ReplaceGeometry(Model& source)
+    {
+        if(uploaded)
+        {
+            uint32_t old = geometry;
+            DeletionQueue::Push([old]{ pool->Free(old); });
+            uploaded = false;
+        }
+
+        TakeGeometry(source);
+        Init();
+    }
+
+    //Копия CPU-данных, чтобы править геометрию, не трогая общую модель из AssetCache
+    void CopyGeometry(const Model& source)
+    {
+        vertices = source.vertices;
+        indices = source.indices;
+        indexType = source.indexType;
+        lods = source.lods;
+        meshlets = source.meshlets;
+        stats = source.stats;
+
+        boundsMin = source.boundsMin;
+        boundsMax = source.boundsMax;
+        boundsCenter = source.boundsCenter;
+        boundsRadius = source.boundsRadius;
+
+        cacheFile = source.cacheFile;
+        cachedVertices = source.cachedVertices;
+        cachedIndices = source.cachedIndices;
+        cachedVertexCount = source.cachedVertexCount;
+        cachedIndexCount = source.cachedIndexCount;
+    }
+
+    //Геометрия меняется - данные из кэша больше не актуальны
+    void ResetCache()
     {
-        createVertexBuffer();
-        createIndexBuffer();
+        cacheFile.reset();
+        cachedVertices = nullptr;
+        cachedIndices = nullptr;
+        cachedVertexCount = 0;
+        cachedIndexCount = 0;
     }
 
-    void createVertexBuffer()
+    //Порядок треугольников под кэш вершин и overdraw, затем LOD и мешлеты,
+    //в конце вершины переставляются в порядке первого обращения по всем уровням.
+    //print = false - для мешей, которые строятся пачками (чанки ландшафта)
+    void Optimize(bool print = printStats)
     {
-        if(vertices.size() == 0) return;
+        float acmrBefore = MeshOptimizer::ACMR(indices, vertices.size());
 
-        VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+        MeshOptimizer::OptimizeVertexCache(indices, vertices.size());
+        MeshOptimizer::OptimizeOverdraw(indices, vertices);
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        Tools::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+        stats.acmrBefore = acmrBefore;
+        stats.acmr = MeshOptimizer::ACMR(indices, vertices.size());
+        stats.atvr = MeshOptimizer::ATVR(indices, vertices.size());
 
-        void* data;
-        vkMapMemory(device->device, stagingBufferMemory, 0, bufferSize, 0, &data);
-            memcpy(data, vertices.data(), (size_t) bufferSize);
-        vkUnmapMemory(device->device, stagingBufferMemory);
+        BuildLods();
+        BuildMeshlets();
 
-        Tools::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+        MeshOptimizer::OptimizeVertexFetch(vertices, indices);
 
-        Tools::copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+        ComputeBounds();
 
-        vkDestroyBuffer(device->device, stagingBuffer, nullptr);
-        vkFreeMemory(device->device, stagingBufferMemory, nullptr);
+        if(print && !indices.empty())
+            std::cout << "mesh " << vertices.size() << " vertices, " << lods[0].indexCount / 3 << " triangles: ACMR "
+                      << stats.acmrBefore << " -> " << stats.acmr << ", ATVR " << stats.atvr << std::endl;
     }
-    
-    void createIndexBuffer() {
 
-        if(indices.size() == 0) return;
+    //Каждый следующий уровень упрощается из предыдущего примерно вдвое,
+    //индексы всех уровней лежат подряд после LOD0 и делят один буфер вершин
+    void BuildLods()
+    {
+        lods.clear();
+        lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f});
 
-        VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+        if(indices.size() < MinLodIndices)
+            return;
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        Tools::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+        std::vector<uint32_t> source = indices;
+        float error = 0.0f;
 
-        void* data;
-        vkMapMemory(device->device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, indices.data(), (size_t) bufferSize);
-        vkUnmapMemory(device->device, stagingBufferMemory);
+        for(int level = 1; level < MaxLods; level++)
+        {
+            float levelError = 0.0f;
+            std::vector<uint32_t> lod = MeshSimplifier::Simplify(vertices, source, source.size() / 6 * 3, &levelError);
+
+            if(lod.empty() || lod.size() > source.size() * 9 / 10)
+                break;
+
+            MeshOptimizer::OptimizeVertexCache(lod, vertices.size());
+
+            error += levelError;
+
+            lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lod.size()), error});
+            indices.insert(indices.end(), lod.begin(), lod.end());
+
+            source = lod;
+        }
+    }
+
+    //Мешлеты режут только LOD0 и переставляют его треугольники на месте,
+    //поэтому обычная отрисовка LOD0 одним вызовом остаётся корректной
+    void BuildMeshlets()
+    {
+        meshlets.clear();
 
-        Tools::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+        if(lods.empty() || lods[0].indexCount / 3 < MinMeshletTriangles)
+            return;
 
-        Tools::copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+        std::vector<uint32_t> lod0(indices.begin(), indices.begin() + lods[0].indexCount);
 
-        vkDestroyBuffer(device->device, stagingBuffer, nullptr);
-        vkFreeMemory(device->device, stagingBufferMemory, nullptr);
+        meshlets = MeshletBuilder::Build(vertices, lod0);
 
+        std::copy(lod0.begin(), lod0.end(), indices.begin());
     }
 
     std::vector<Vertex> vertices;
 
-    std::vector<uint16_t> indices;
-    
-    VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
-    VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
-    VkImage textureImage;
-    VkDeviceMemory textureImageMemory;
+    //Хранятся 32-битными, при загрузке в пул упаковываются в 16 бит, если вершин мало
+    std::vector<uint32_t> indices;
+
+    VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+
+    //vertices всегда во float, раскладка применяется только при загрузке в пул
+    VertexLayout layout;
+    glm::mat4 dequantize = glm::mat4(1.0f);
+
+    std::vector<ModelLod> lods;
+
+    std::vector<Meshlet> meshlets;
+
+    MeshStats stats;
+
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+
+    //Геометрия из отображённого файла кэша: vertices/indices при этом пустые
+    std::shared_ptr<MappedFile> cacheFile;
+    const Vertex* cachedVertices = nullptr;
+    const void* cachedIndices = nullptr;
+    uint32_t cachedVertexCount = 0;
+    uint32_t cachedIndexCount = 0;
+
+    uint32_t geometry;
+    bool uploaded = false;
 
     Device* device;
 
-};
\ No newline at end of file
+    inline static GeometryPool* pool;
+
+    inline static bool printStats = true;
+
+    inline static const int MaxLods = 4;
+    inline static const size_t MinLodIndices = 768;
+    inline static const uint32_t MinMeshletTriangles = 512;
+
+private:
+    void unpackCache()
+    {
+        vertices.assign(cachedVertices, cachedVertices + cachedVertexCount);
+
+        if(indexType == VK_INDEX_TYPE_UINT16)
+        {
+            const uint16_t* source = static_cast<const uint16_t*>(cachedIndices);
+            indices.assign(source, source + cachedIndexCount);
+        }
+        else
+        {
+            const uint32_t* source = static_cast<const uint32_t*>(cachedIndices);
+            indices.assign(source, source + cachedIndexCount);
+        }
+
+        ResetCache();
+    }
+};
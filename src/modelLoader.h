@@ -0,0 +1,81 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "model.h"
+#include "meshCache.h"
+#include "objParser.h"
+
+//Разбор модели с диска в CPU-данные Model, без обращений к Vulkan: можно звать из рабочего потока
+class ModelLoader{
+public:
+    static void LoadObj(const std::string& filepath, Model& model)
+    {
+        model.vertices.clear();
+        model.indices.clear();
+        model.lods.clear();
+        model.meshlets.clear();
+        model.ResetCache();
+
+        //Готовый бинарный кэш рядом с исходником, если он собран из этого же файла
+        std::string cachePath = MeshCache::GetPath(filepath);
+        uint64_t sourceHash = MeshCache::HashFile(filepath);
+
+        if (sourceHash != 0 && MeshCache::Load(cachePath, sourceHash, model)) {
+            std::cout << filepath << ": loaded from " << cachePath << ", " << model.cachedVertexCount << " vertices, "
+                      << model.lods[0].indexCount / 3 << " triangles" << std::endl;
+            return;
+        }
+
+        ObjData obj;
+        std::string err;
+
+        if (!ObjParser::Load(filepath, obj, err)) {
+            throw std::runtime_error(err);
+        }
+
+        std::vector<Vertex> corners(obj.indices.size());
+
+        for (size_t i = 0; i < obj.indices.size(); i++) {
+            const ObjIndex& index = obj.indices[i];
+            Vertex vertex{};
+
+            vertex.pos = {
+                obj.positions[3 * index.vertex + 0],
+                obj.positions[3 * index.vertex + 1],
+                obj.positions[3 * index.vertex + 2]
+            };
+
+            if (index.normal >= 0) {
+                vertex.normal = {
+                    obj.normals[index.normal * 3 + 0],
+                    obj.normals[index.normal * 3 + 1],
+                    obj.normals[index.normal * 3 + 2]
+                };
+            }
+
+            if (index.texCoord >= 0) {
+                vertex.texCoord = {
+                    obj.texCoords[2 * index.texCoord + 0],
+                    1.0f - obj.texCoords[2 * index.texCoord + 1]
+                };
+            }
+
+            vertex.color = {0.5f, 0.5f, 0.5f};
+
+            corners[i] = vertex;
+        }
+
+        //Одна вершина на угол треугольника - склеиваем одинаковые
+        MeshOptimizer::Weld(corners, model.vertices, model.indices);
+
+        std::cout << filepath << ": " << corners.size() << " corners -> " << model.vertices.size() << " vertices, "
+                  << model.indices.size() / 3 << " triangles, "
+                  << (MeshOptimizer::IndexTypeFor(model.vertices.size()) == VK_INDEX_TYPE_UINT16 ? 16 : 32) << "-bit indices" << std::endl;
+
+        model.Optimize();
+
+        if (!MeshCache::Save(cachePath, sourceHash, model))
+            std::cerr << "failed to write mesh cache " << cachePath << std::endl;
+    }
+};
@@ -0,0 +1,499 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "vfs.h"
+
+#include <charconv>
+#include <thread>
+
+//Индексы угла треугольника, как tinyobj::index_t: с нуля, -1 - атрибута нет
+struct ObjIndex{
+    int vertex;
+    int normal;
+    int texCoord;
+};
+
+//То же, что tinyobj::attrib_t + индексы всех shape подряд, уже разбитые на треугольники
+struct ObjData{
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> texCoords;
+    std::vector<ObjIndex> indices;
+};
+
+//Многопоточный разбор OBJ: файл отображается в память и режется на куски по границам строк,
+//каждый поток разбирает свой кусок, затем по префиксным суммам куски сливаются в общие массивы.
+//Читает только v/vn/vt/f, остальные строки пропускаются
+class ObjParser{
+public:
+    static bool Load(const std::string& path, ObjData& data, std::string& error, uint32_t threadCount = 0)
+    {
+        MappedFile file;
+        if(!Vfs::Open(path, file))
+        {
+            error = "failed to open " + path + "!";
+            return false;
+        }
+
+        const char* begin = reinterpret_cast<const char*>(file.GetData());
+        return Parse(begin, begin + file.GetSize(), data, error, threadCount);
+    }
+
+    static bool Parse(const char* begin, const char* end, ObjData& data, std::string& error, uint32_t threadCount = 0)
+    {
+        data = ObjData{};
+
+        if(threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+        size_t size = end - begin;
+        uint32_t chunkCount = static_cast<uint32_t>(std::min<size_t>(threadCount, size / MinChunkBytes + 1));
+
+        //Начало каждого куска сдвигается на начало следующей строки
+        std::vector<const char*> bounds(chunkCount + 1);
+        bounds[0] = begin;
+        bounds[chunkCount] = end;
+        for(uint32_t i = 1; i < chunkCount; i++)
+        {
+            const char* p = std::max(begin + size / chunkCount * i, bounds[i - 1]);
+            while(p < end && *p != '\n')
+                p++;
+            bounds[i] = p < end ? p + 1 : end;
+        }
+
+        std::vector<Chunk> chunks(chunkCount);
+        parallelFor(chunkCount, [&](uint32_t i){ parseChunk(bounds[i], bounds[i + 1], chunks[i]); });
+
+        for(auto& chunk : chunks)
+            if(!chunk.error.empty())
+            {
+                error = chunk.error;
+                return false;
+            }
+
+        //Смещения кусков в общих массивах
+        size_t positionCount = 0, normalCount = 0, texCoordCount = 0;
+        for(auto& chunk : chunks)
+        {
+            chunk.positionOffset = positionCount;
+            chunk.normalOffset = normalCount;
+            chunk.texCoordOffset = texCoordCount;
+
+            positionCount += chunk.positions.size() / 3;
+            normalCount += chunk.normals.size() / 3;
+            texCoordCount += chunk.texCoords.size() / 2;
+        }
+
+        data.positions.resize(positionCount * 3);
+        data.normals.resize(normalCount * 3);
+        data.texCoords.resize(texCoordCount * 2);
+
+        parallelFor(chunkCount, [&](uint32_t i){ resolveChunk(chunks[i], data); });
+
+        for(auto& chunk : chunks)
+            if(!chunk.error.empty())
+            {
+                error = chunk.error;
+                return false;
+            }
+
+        //Для разбиения граней нужны уже все позиции. Сколько треугольников даст n-угольник,
+        //известно только после разбиения, поэтому куски пишут к себе и копируются вторым проходом
+        parallelFor(chunkCount, [&](uint32_t i){ triangulateChunk(chunks[i], data); });
+
+        size_t indexCount = 0;
+        for(auto& chunk : chunks)
+        {
+            chunk.indexOffset = indexCount;
+            indexCount += chunk.triangles.size();
+        }
+
+        data.indices.resize(indexCount);
+
+        parallelFor(chunkCount, [&](uint32_t i){
+            std::copy(chunks[i].triangles.begin(), chunks[i].triangles.end(), data.indices.begin() + chunks[i].indexOffset);
+        });
+
+        return true;
+    }
+
+    inline static const size_t MinChunkBytes = 1 << 20;
+
+private:
+    struct Chunk{
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<float> texCoords;
+
+        //Углы всех граней подряд, faceSizes - число углов каждой грани
+        std::vector<ObjIndex> corners;
+        std::vector<uint32_t> faceSizes;
+
+        //Углы с отрицательными индексами: посчитаны от начала куска, смещение куска добавляется при слиянии
+        std::vector<std::pair<uint32_t, uint8_t>> relative;
+
+        //Верхняя оценка: ear clipping может отбросить часть n-угольника
+        size_t triangleCount = 0;
+        std::vector<ObjIndex> triangles;
+
+        size_t positionOffset = 0;
+        size_t normalOffset = 0;
+        size_t texCoordOffset = 0;
+        size_t indexOffset = 0;
+
+        std::string error;
+    };
+
+    enum RelativeMask : uint8_t{
+        RelativeVertex = 1,
+        RelativeTexCoord = 2,
+        RelativeNormal = 4
+    };
+
+    template<typename Func>
+    static void parallelFor(uint32_t count, Func func)
+    {
+        if(count == 1)
+        {
+            func(0);
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        threads.reserve(count);
+        for(uint32_t i = 0; i < count; i++)
+            threads.emplace_back(func, i);
+
+        for(auto& thread : threads)
+            thread.join();
+    }
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    static bool isLineEnd(const char* p, const char* end)
+    {
+        return p >= end || *p == '\n' || *p == '\r' || *p == '#';
+    }
+
+    static const char* skipSpaces(const char* p, const char* end)
+    {
+        while(p < end && isSpace(*p))
+            p++;
+        return p;
+    }
+
+    static const char* parseFloat(const char* p, const char* end, float& value)
+    {
+        p = skipSpaces(p, end);
+        if(p < end && *p == '+')
+            p++;
+
+        auto result = std::from_chars(p, end, value);
+        return result.ec == std::errc() ? result.ptr : nullptr;
+    }
+
+    static bool parseFloats(const char* p, const char* end, int count, std::vector<float>& out)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            float value;
+            p = parseFloat(p, end, value);
+            if(p == nullptr)
+                return false;
+
+            out.push_back(value);
+        }
+
+        return true;
+    }
+
+    //Индекс OBJ с единицы; отрицательный считается от текущего конца массива
+    static const char* parseIndex(const char* p, const char* end, int& value, size_t localCount, bool& relative)
+    {
+        int raw = 0;
+        auto result = std::from_chars(p, end, raw);
+        if(result.ec != std::errc() || raw == 0)
+            return nullptr;
+
+        relative = raw < 0;
+        value = relative ? static_cast<int>(localCount) + raw : raw - 1;
+
+        return result.ptr;
+    }
+
+    static void parseChunk(const char* p, const char* end, Chunk& chunk)
+    {
+        while(p < end)
+        {
+            const char* lineStart = p;
+            p = skipSpaces(p, end);
+
+            bool ok = true;
+
+            if(p + 1 < end && p[0] == 'v' && isSpace(p[1]))
+                ok = parseFloats(p + 2, end, 3, chunk.positions);
+            else if(p + 2 < end && p[0] == 'v' && p[1] == 'n' && isSpace(p[2]))
+                ok = parseFloats(p + 3, end, 3, chunk.normals);
+            else if(p + 2 < end && p[0] == 'v' && p[1] == 't' && isSpace(p[2]))
+                ok = parseFloats(p + 3, end, 2, chunk.texCoords);
+            else if(p + 1 < end && p[0] == 'f' && isSpace(p[1]))
+                ok = parseFace(p + 2, end, chunk);
+
+            if(!ok)
+            {
+                const char* lineEnd = lineStart;
+                while(lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r')
+                    lineEnd++;
+
+                chunk.error = "failed to parse OBJ line: " + std::string(lineStart, lineEnd);
+                return;
+            }
+
+            while(p < end && *p != '\n')
+                p++;
+            if(p < end)
+                p++;
+        }
+    }
+
+    static bool parseFace(const char* p, const char* end, Chunk& chunk)
+    {
+        uint32_t count = 0;
+
+        while(true)
+        {
+            p = skipSpaces(p, end);
+            if(isLineEnd(p, end))
+                break;
+
+            ObjIndex index{-1, -1, -1};
+            uint8_t mask = 0;
+            bool relative;
+
+            p = parseIndex(p, end, index.vertex, chunk.positions.size() / 3, relative);
+            if(p == nullptr)
+                return false;
+            if(relative)
+                mask |= RelativeVertex;
+
+            if(p < end && *p == '/')
+            {
+                p++;
+                if(p < end && *p != '/')
+                {
+                    p = parseIndex(p, end, index.texCoord, chunk.texCoords.size() / 2, relative);
+                    if(p == nullptr)
+                        return false;
+                    if(relative)
+                        mask |= RelativeTexCoord;
+                }
+
+                if(p < end && *p == '/')
+                {
+                    p++;
+                    p = parseIndex(p, end, index.normal, chunk.normals.size() / 3, relative);
+                    if(p == nullptr)
+                        return false;
+                    if(relative)
+                        mask |= RelativeNormal;
+                }
+            }
+
+            if(p < end && !isSpace(*p) && !isLineEnd(p, end))
+                return false;
+
+            if(mask)
+                chunk.relative.push_back({static_cast<uint32_t>(chunk.corners.size()), mask});
+
+            chunk.corners.push_back(index);
+            count++;
+        }
+
+        //Как и tinyobj, грани меньше чем из трёх углов пропускаем
+        if(count < 3)
+        {
+            chunk.corners.resize(chunk.corners.size() - count);
+            while(!chunk.relative.empty() && chunk.relative.back().first >= chunk.corners.size())
+                chunk.relative.pop_back();
+            return true;
+        }
+
+        chunk.faceSizes.push_back(count);
+        chunk.triangleCount += count - 2;
+
+        return true;
+    }
+
+    static void resolveChunk(Chunk& chunk, ObjData& data)
+    {
+        std::copy(chunk.positions.begin(), chunk.positions.end(), data.positions.begin() + chunk.positionOffset * 3);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), data.normals.begin() + chunk.normalOffset * 3);
+        std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), data.texCoords.begin() + chunk.texCoordOffset * 2);
+
+        for(auto& [corner, mask] : chunk.relative)
+        {
+            ObjIndex& index = chunk.corners[corner];
+            if(mask & RelativeVertex)
+                index.vertex += static_cast<int>(chunk.positionOffset);
+            if(mask & RelativeTexCoord)
+                index.texCoord += static_cast<int>(chunk.texCoordOffset);
+            if(mask & RelativeNormal)
+                index.normal += static_cast<int>(chunk.normalOffset);
+        }
+
+        int positionCount = static_cast<int>(data.positions.size() / 3);
+        int normalCount = static_cast<int>(data.normals.size() / 3);
+        int texCoordCount = static_cast<int>(data.texCoords.size() / 2);
+
+        for(auto& index : chunk.corners)
+            if(index.vertex < 0 || index.vertex >= positionCount || index.normal >= normalCount || index.texCoord >= texCoordCount ||
+               index.normal < -1 || index.texCoord < -1)
+            {
+                chunk.error = "OBJ face index out of range!";
+                return;
+            }
+    }
+
+    //Треугольники как у tinyobj без earcut: четырёхугольник по короткой диагонали, больше - ear clipping
+    static void triangulateChunk(Chunk& chunk, const ObjData& data)
+    {
+        std::vector<ObjIndex>& out = chunk.triangles;
+        out.reserve(chunk.triangleCount * 3);
+
+        std::vector<ObjIndex> remaining;
+        const ObjIndex* face = chunk.corners.data();
+
+        for(uint32_t count : chunk.faceSizes)
+        {
+            if(count == 4)
+            {
+                glm::vec3 p[4];
+                for(int i = 0; i < 4; i++)
+                    p[i] = position(data, face[i]);
+
+                glm::vec3 e02 = p[2] - p[0];
+                glm::vec3 e13 = p[3] - p[1];
+
+                if(glm::dot(e02, e02) < glm::dot(e13, e13))
+                    out.insert(out.end(), {face[0], face[1], face[2], face[0], face[2], face[3]});
+                else
+                    out.insert(out.end(), {face[0], face[1], face[3], face[1], face[2], face[3]});
+            }
+            else
+            {
+                remaining.assign(face, face + count);
+                earClip(data, remaining, out);
+            }
+
+            face += count;
+        }
+    }
+
+    //Порт встроенной триангуляции tinyobj, включая её странности, чтобы результат совпадал
+    //до индекса: грань проецируется на две оси по первому невырожденному углу, уши отрезаются
+    //по кругу; если за целый оборот ухо не нашлось, остаток грани отбрасывается
+    static void earClip(const ObjData& data, std::vector<ObjIndex>& remaining, std::vector<ObjIndex>& out)
+    {
+        size_t count = remaining.size();
+
+        int axes[2] = {1, 2};
+        for(size_t k = 0; k < count; k++)
+        {
+            glm::vec3 e0 = position(data, remaining[(k + 1) % count]) - position(data, remaining[k]);
+            glm::vec3 e1 = position(data, remaining[(k + 2) % count]) - position(data, remaining[(k + 1) % count]);
+
+            float cx = std::fabs(e0.y * e1.z - e0.z * e1.y);
+            float cy = std::fabs(e0.z * e1.x - e0.x * e1.z);
+            float cz = std::fabs(e0.x * e1.y - e0.y * e1.x);
+
+            const float epsilon = std::numeric_limits<float>::epsilon();
+            if(cx > epsilon || cy > epsilon || cz > epsilon)
+            {
+                if(!(cx > cy && cx > cz))
+                {
+                    axes[0] = 0;
+                    if(cz > cx && cz > cy)
+                        axes[1] = 1;
+                }
+                break;
+            }
+        }
+
+        size_t guess = 0;
+        size_t iterations = count;
+        size_t previousCount = count;
+
+        while(remaining.size() > 3 && iterations > 0)
+        {
+            size_t n = remaining.size();
+            if(guess >= n)
+                guess -= n;
+
+            //Итерации считаются заново каждый раз, когда грань уменьшилась
+            if(previousCount != n)
+            {
+                previousCount = n;
+                iterations = n;
+            }
+            else
+                iterations--;
+
+            ObjIndex corner[3];
+            float x[3], y[3];
+            for(int k = 0; k < 3; k++)
+            {
+                corner[k] = remaining[(guess + k) % n];
+                x[k] = data.positions[corner[k].vertex * 3 + axes[0]];
+                y[k] = data.positions[corner[k].vertex * 3 + axes[1]];
+            }
+
+            //Знак угла сравнивается не с площадью грани, а с (x0 * y1 - y0 * x1) - так у tinyobj
+            float cross = (x[1] - x[0]) * (y[2] - y[1]) - (y[1] - y[0]) * (x[2] - x[1]);
+            float area = (x[0] * y[1] - y[0] * x[1]) * 0.5f;
+            if(cross * area < 0.0f)
+            {
+                guess++;
+                continue;
+            }
+
+            bool overlap = false;
+            for(size_t other = 3; other < n && !overlap; other++)
+            {
+                const ObjIndex& index = remaining[(guess + other) % n];
+                overlap = insideTriangle(x, y, data.positions[index.vertex * 3 + axes[0]], data.positions[index.vertex * 3 + axes[1]]);
+            }
+
+            if(overlap)
+            {
+                guess++;
+                continue;
+            }
+
+            out.insert(out.end(), corner, corner + 3);
+            remaining.erase(remaining.begin() + (guess + 1) % n);
+        }
+
+        if(remaining.size() == 3)
+            out.insert(out.end(), remaining.begin(), remaining.end());
+    }
+
+    //pnpoly для трёх вершин
+    static bool insideTriangle(const float* x, const float* y, float px, float py)
+    {
+        bool inside = false;
+        for(int i = 0, j = 2; i < 3; j = i++)
+            if(((y[i] > py) != (y[j] > py)) && (px < (x[j] - x[i]) * (py - y[i]) / (y[j] - y[i]) + x[i]))
+                inside = !inside;
+
+        return inside;
+    }
+
+    static glm::vec3 position(const ObjData& data, const ObjIndex& index)
+    {
+        return glm::vec3(data.positions[index.vertex * 3 + 0], data.positions[index.vertex * 3 + 1], data.positions[index.vertex * 3 + 2]);
+    }
+};
@@ -3,6 +3,22 @@
 #include "stdinclude.h"
 
 #include "device.h"
+#include "vertexLayout.h"
+
+//Из чего собран uniform-буфер кадра: при совпадении запись пропускается
+struct UniformStamp{
+    uint32_t transform = UINT32_MAX;
+    uint32_t transformVersion = 0;
+    uint32_t cameraVersion = 0;
+    uint32_t lightVersion = 0;
+    glm::mat4 dequantize = glm::mat4(1.0f);
+
+    bool operator==(const UniformStamp& other) const
+    {
+        return transform == other.transform && transformVersion == other.transformVersion && cameraVersion == other.cameraVersion &&
+               lightVersion == other.lightVersion && dequantize == other.dequantize;
+    }
+};
 
 class Pipeline{
 
@@ -20,14 +36,11 @@ public:
         vkDestroyPipelineLayout(device->device, pipelineLayout, nullptr);
 
         for (size_t i = 0; i < uniformBuffers.size(); i++) {
+            vkUnmapMemory(device->device, uniformBuffersMemory[i]);
             vkDestroyBuffer(device->device, uniformBuffers[i], nullptr);
             vkFreeMemory(device->device, uniformBuffersMemory[i], nullptr);
         }
 
-        
-        vkDestroySampler(device->device, textureSampler, nullptr);
-        vkDestroyImageView(device->device, textureImageView, nullptr);
-
     }
 
     void Init()
@@ -165,33 +178,69 @@ public:
         }
     }
 
+    //Новая картинка в binding 1 всех наборов; набор уже не должен использоваться GPU
+    void UpdateTextureDescriptors() {
+        if(descriptorSets.empty() || textureImageView == VK_NULL_HANDLE)
+            return;
+
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = textureImageView;
+        imageInfo.sampler = textureSampler;
+
+        std::vector<VkWriteDescriptorSet> descriptorWrites(descriptorSets.size());
+        for (size_t i = 0; i < descriptorSets.size(); i++) {
+            descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[i].dstSet = descriptorSets[i];
+            descriptorWrites[i].dstBinding = 1;
+            descriptorWrites[i].dstArrayElement = 0;
+            descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            descriptorWrites[i].descriptorCount = 1;
+            descriptorWrites[i].pImageInfo = &imageInfo;
+        }
+
+        vkUpdateDescriptorSets(device->device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    //Память остаётся отображённой до удаления пайплайна
     void createUniformBuffers() {
         VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
         uniformBuffers.resize(Resource::countFrames);
         uniformBuffersMemory.resize(Resource::countFrames);
+        uniformBuffersMapped.resize(Resource::countFrames);
+        uniformStamps.assign(Resource::countFrames, UniformStamp{});
 
         for (size_t i = 0; i < Resource::countFrames; i++) {
             Tools::createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
+            vkMapMemory(device->device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
         }
     }
 
     Device* device = NULL;
 
-    VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline graphicsPipeline = VK_NULL_HANDLE;
     
     VkDescriptorSetLayout descriptorSetLayout;
     VkDescriptorPool descriptorPool;
     
     std::vector<VkBuffer> uniformBuffers;
     std::vector<VkDeviceMemory> uniformBuffersMemory;
+    std::vector<void*> uniformBuffersMapped;
+    std::vector<UniformStamp> uniformStamps;
 
     
+    //Принадлежат Texture сущности
     VkImageView textureImageView = VK_NULL_HANDLE;
-    VkSampler textureSampler;
+    VkSampler textureSampler = VK_NULL_HANDLE;
 
     VkFrontFace face = VK_FRONT_FACE_CLOCKWISE;
 
+    VertexLayout vertexLayout;
+
+    //Пайплайн глубины/теней: в vertex input только позиции из binding 0
+    bool positionsOnly = false;
+
     std::vector<VkDescriptorSet> descriptorSets;
 };
\ No newline at end of file
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include <memory>
+
+typedef uint32_t EntityId;
+
+const EntityId NullEntity = UINT32_MAX;
+
+//Младшие 24 бита - индекс, старшие 8 - поколение
+inline uint32_t EntityIndex(EntityId entity)
+{
+    return entity & 0xFFFFFF;
+}
+
+class ComponentPoolBase{
+public:
+    virtual ~ComponentPoolBase(){}
+    virtual void Remove(EntityId entity) = 0;
+};
+
+//Sparse set: компоненты одного типа лежат подряд, sparse-массив переводит индекс сущности в плотный индекс
+template<typename T>
+class ComponentPool : public ComponentPoolBase{
+public:
+    T& Add(EntityId entity, const T& component)
+    {
+        uint32_t index = EntityIndex(entity);
+
+        if(index >= sparse.size())
+            sparse.resize(index + 1, Invalid);
+
+        if(sparse[index] != Invalid)
+        {
+            components[sparse[index]] = component;
+            return components[sparse[index]];
+        }
+
+        sparse[index] = static_cast<uint32_t>(dense.size());
+        dense.push_back(entity);
+        components.push_back(component);
+
+        return components.back();
+    }
+
+    void Remove(EntityId entity) override
+    {
+        if(!Has(entity))
+            return;
+
+        uint32_t index = EntityIndex(entity);
+        uint32_t slot = sparse[index];
+        uint32_t last = static_cast<uint32_t>(dense.size() - 1);
+
+        if(slot != last)
+        {
+            dense[slot] = dense[last];
+            components[slot] = std::move(components[last]);
+            sparse[EntityIndex(dense[slot])] = slot;
+        }
+
+        dense.pop_back();
+        components.pop_back();
+        sparse[index] = Invalid;
+    }
+
+    bool Has(EntityId entity)
+    {
+        uint32_t index = EntityIndex(entity);
+        return index < sparse.size() && sparse[index] != Invalid && dense[sparse[index]] == entity;
+    }
+
+    T& Get(EntityId entity)
+    {
+        return components[sparse[EntityIndex(entity)]];
+    }
+
+    size_t Size() { return dense.size(); }
+
+    std::vector<EntityId> dense;
+    std::vector<T> components;
+
+private:
+    inline static const uint32_t Invalid = UINT32_MAX;
+
+    std::vector<uint32_t> sparse;
+};
+
+class Registry{
+public:
+    Registry(){}
+    ~Registry(){}
+
+    EntityId Create()
+    {
+        uint32_t index;
+
+        if(!freeIndices.empty())
+        {
+            index = freeIndices.back();
+            freeIndices.pop_back();
+        }
+        else
+        {
+            index = static_cast<uint32_t>(generations.size());
+            generations.push_back(0);
+        }
+
+        return index | (generations[index] << 24);
+    }
+
+    void Destroy(EntityId entity)
+    {
+        if(!Valid(entity))
+            return;
+
+        for(auto& pool : pools)
+            if(pool)
+                pool->Remove(entity);
+
+        uint32_t index = EntityIndex(entity);
+        generations[index] = (generations[index] + 1) & 0xFF;
+        freeIndices.push_back(index);
+    }
+
+    bool Valid(EntityId entity)
+    {
+        uint32_t index = EntityIndex(entity);
+        return entity != NullEntity && index < generations.size() && generations[index] == (entity >> 24);
+    }
+
+    template<typename T>
+    T& Add(EntityId entity, const T& component = T())
+    {
+        return Pool<T>().Add(entity, component);
+    }
+
+    template<typename T>
+    void Remove(EntityId entity)
+    {
+        Pool<T>().Remove(entity);
+    }
+
+    template<typename T>
+    bool Has(EntityId entity)
+    {
+        return Pool<T>().Has(entity);
+    }
+
+    template<typename T>
+    T& Get(EntityId entity)
+    {
+        return Pool<T>().Get(entity);
+    }
+
+    //Проход по плотному массиву первого компонента, остальные берутся через sparse
+    template<typename T, typename... Others, typename F>
+    void Each(F func)
+    {
+        ComponentPool<T>& pool = Pool<T>();
+
+        for(size_t i = 0; i < pool.dense.size(); i++)
+        {
+            EntityId entity = pool.dense[i];
+
+            if((Pool<Others>().Has(entity) && ...))
+                func(entity, pool.components[i], Pool<Others>().Get(entity)...);
+        }
+    }
+
+    template<typename T>
+    ComponentPool<T>& Pool()
+    {
+        uint32_t id = TypeId<T>();
+
+        if(id >= pools.size())
+            pools.resize(id + 1);
+
+        if(!pools[id])
+            pools[id] = std::make_unique<ComponentPool<T>>();
+
+        return *static_cast<ComponentPool<T>*>(pools[id].get());
+    }
+
+private:
+    template<typename T>
+    static uint32_t TypeId()
+    {
+        static uint32_t id = nextTypeId++;
+        return id;
+    }
+
+    inline static uint32_t nextTypeId = 0;
+
+    std::vector<std::unique_ptr<ComponentPoolBase>> pools;
+
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> freeIndices;
+};
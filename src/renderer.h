@@ -7,6 +7,8 @@
 #include "resource.h"
 
 #include "pipeline.h"
+#include "deletionQueue.h"
+#include "vfs.h"
 
 class Renderer{
 public:
@@ -14,9 +16,13 @@ public:
         this->device = device;
         createRenderPass();
         createCommandPool();     
+        createPipelineCache();
     }
     ~Renderer(){
 
+        savePipelineCache();
+        vkDestroyPipelineCache(device->device, pipelineCache, nullptr);
+
         vkDestroyRenderPass(device->device, renderPass, nullptr);
         
         vkDestroyCommandPool(device->device, Resource::commandPool, nullptr);
@@ -95,13 +101,90 @@ public:
         }
     }
     
+    //Драйвер сам проверяет, что данные кэша от того же устройства и версии, и иначе их игнорирует
+    void createPipelineCache() {
+        std::vector<char> data;
+
+        std::ifstream file(PipelineCachePath, std::ios::ate | std::ios::binary);
+        if(file)
+        {
+            data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(data.data(), data.size());
+            if(!file)
+                data.clear();
+        }
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = data.size();
+        cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+        if (vkCreatePipelineCache(device->device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+
+    void savePipelineCache() {
+        size_t size = 0;
+        if(vkGetPipelineCacheData(device->device, pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0)
+            return;
+
+        std::vector<char> data(size);
+        if(vkGetPipelineCacheData(device->device, pipelineCache, &size, data.data()) != VK_SUCCESS)
+            return;
+
+        std::string temp = std::string(PipelineCachePath) + ".tmp";
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if(!file)
+                return;
+
+            file.write(data.data(), size);
+            if(!file)
+                return;
+        }
+
+        std::remove(PipelineCachePath);
+        std::rename(temp.c_str(), PipelineCachePath);
+    }
+
+    //Пересборка после правки шейдера: старый пайплайн удаляется, когда его не читает ни один кадр.
+    //Если новый шейдер не собрался, остаётся старый
+    bool rebuildGraphicsPipeline(std::string vertFile, std::string fragFile, Pipeline* pipeline) {
+        VkPipeline old = pipeline->graphicsPipeline;
+
+        try{
+            createGraphicsPipeline(vertFile, fragFile, pipeline);
+        }catch(const std::exception& e){
+            std::cerr << "failed to rebuild pipeline " << vertFile << " / " << fragFile << ": " << e.what() << std::endl;
+            pipeline->graphicsPipeline = old;
+            return false;
+        }
+
+        Device* device = this->device;
+        DeletionQueue::Push([device, old]{ vkDestroyPipeline(device->device, old, nullptr); });
+        return true;
+    }
+
     void createGraphicsPipeline(std::string vertFile, std::string fragFile, Pipeline* pipeline) {
 
         auto vertShaderCode = readFile(vertFile);
         auto fragShaderCode = readFile(fragFile);
 
+        //Недописанный редактором или битый файл не должен доходить до драйвера
+        if(!isSpirv(vertShaderCode) || !isSpirv(fragShaderCode))
+            throw std::runtime_error("invalid SPIR-V in " + vertFile + " or " + fragFile + "!");
+
         VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-        VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+        VkShaderModule fragShaderModule;
+        try{
+            fragShaderModule = createShaderModule(fragShaderCode);
+        }catch(...){
+            //При горячей перезагрузке ошибка не роняет программу, модуль вершинного шейдера не должен утечь
+            vkDestroyShaderModule(device->device, vertShaderModule, nullptr);
+            throw;
+        }
 
         VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
         vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -122,12 +205,12 @@ public:
         vertexInputInfo.vertexBindingDescriptionCount = 0;
         vertexInputInfo.vertexAttributeDescriptionCount = 0;
 
-        auto bindingDescription = Vertex::getBindingDescription();
-        auto attributeDescriptions = Vertex::getAttributeDescriptions();
+        auto bindingDescriptions = pipeline->vertexLayout.GetBindingDescriptions(pipeline->positionsOnly);
+        auto attributeDescriptions = pipeline->vertexLayout.GetAttributeDescriptions(pipeline->positionsOnly);
 
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
         vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
         vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
         VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -196,7 +279,9 @@ public:
         pipelineLayoutInfo.pSetLayouts = &pipeline->descriptorSetLayout;
         pipelineLayoutInfo.pushConstantRangeCount = 0;
 
-        if (vkCreatePipelineLayout(device->device, &pipelineLayoutInfo, nullptr, &pipeline->pipelineLayout) != VK_SUCCESS) {
+        //Раскладка не зависит от шейдеров и при пересборке остаётся прежней
+        if (pipeline->pipelineLayout == VK_NULL_HANDLE &&
+            vkCreatePipelineLayout(device->device, &pipelineLayoutInfo, nullptr, &pipeline->pipelineLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create pipeline layout!");
         }
 
@@ -229,12 +314,28 @@ public:
 
         pipelineInfo.pDepthStencilState = &depthStencil;
 
-        if (vkCreateGraphicsPipelines(device->device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline->graphicsPipeline) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create graphics pipeline!");
-        }
+        VkPipeline graphicsPipeline;
+        VkResult result = vkCreateGraphicsPipelines(device->device, pipelineCache, 1, &pipelineInfo, nullptr, &graphicsPipeline);
 
         vkDestroyShaderModule(device->device, fragShaderModule, nullptr);
         vkDestroyShaderModule(device->device, vertShaderModule, nullptr);
+
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create graphics pipeline!");
+        }
+
+        pipeline->graphicsPipeline = graphicsPipeline;
+    }
+
+    static bool isSpirv(const std::vector<char>& code) {
+        const uint32_t SpirvMagic = 0x07230203;
+
+        uint32_t magic = 0;
+        if(code.size() < 20 || code.size() % 4 != 0)
+            return false;
+
+        memcpy(&magic, code.data(), sizeof(magic));
+        return magic == SpirvMagic;
     }
 
     VkShaderModule createShaderModule(const std::vector<char>& code) {
@@ -275,25 +376,15 @@ public:
     }
 
     static std::vector<char> readFile(const std::string& filename) {
-        std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-        if (!file.is_open()) {
-            throw std::runtime_error("failed to open file!");
-        }
-
-        size_t fileSize = (size_t) file.tellg();
-        std::vector<char> buffer(fileSize);
-
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-
-        file.close();
-
-        return buffer;
+        return Vfs::ReadFile(filename);
     }
     
     VkRenderPass renderPass;
 
+    //Общий на все пайплайны, сохраняется между запусками
+    inline static VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    inline static const char* PipelineCachePath = "pipeline.cache";
+
     Device* device;
 
 };
\ No newline at end of file
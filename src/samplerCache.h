@@ -0,0 +1,94 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "device.h"
+
+//Всё, чем различаются сэмплеры. Число уровней не входит: maxLod не ограничен,
+//цепочку режет вид картинки, поэтому один сэмплер подходит любой текстуре
+struct SamplerState{
+    VkFilter filter = VK_FILTER_LINEAR;
+    VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    bool anisotropic = true;
+
+    bool operator==(const SamplerState& other) const
+    {
+        return filter == other.filter && mipmapMode == other.mipmapMode && addressMode == other.addressMode && anisotropic == other.anisotropic;
+    }
+};
+
+//Общие сэмплеры на всё приложение, по одному на SamplerState. Текстуры только ссылаются
+//на них; удаляются все разом в Destroy при выходе
+class SamplerCache{
+public:
+    //После создания устройства, до первой текстуры. anisotropy обрезается по лимиту устройства
+    static void Init(Device* device)
+    {
+        SamplerCache::device = device;
+
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(device->physicalDevice, &properties);
+
+        anisotropy = std::clamp(anisotropy, 1.0f, properties.limits.maxSamplerAnisotropy);
+    }
+
+    static VkSampler Get(const SamplerState& state)
+    {
+        for(auto& entry : samplers)
+            if(entry.first == state)
+                return entry.second;
+
+        bool anisotropic = state.anisotropic && anisotropy > 1.0f;
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = state.filter;
+        samplerInfo.minFilter = state.filter;
+        samplerInfo.addressModeU = state.addressMode;
+        samplerInfo.addressModeV = state.addressMode;
+        samplerInfo.addressModeW = state.addressMode;
+
+        samplerInfo.anisotropyEnable = anisotropic ? VK_TRUE : VK_FALSE;
+        samplerInfo.maxAnisotropy = anisotropic ? anisotropy : 1.0f;
+        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_FALSE;
+        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        samplerInfo.mipmapMode = state.mipmapMode;
+        samplerInfo.mipLodBias = 0.0f;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+        VkSampler sampler;
+        if (vkCreateSampler(device->device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture sampler!");
+        }
+
+        samplers.push_back({state, sampler});
+        return sampler;
+    }
+
+    //При выходе, когда GPU уже ничего не читает
+    static void Destroy()
+    {
+        for(auto& entry : samplers)
+            vkDestroySampler(device->device, entry.second, nullptr);
+
+        samplers.clear();
+    }
+
+    static size_t GetCount()
+    {
+        return samplers.size();
+    }
+
+    //Общий уровень анизотропии; меняется до Init, 1 - выключена
+    inline static float anisotropy = 16.0f;
+
+private:
+    //Разных состояний единицы, линейный поиск быстрее хэша
+    inline static std::vector<std::pair<SamplerState, VkSampler>> samplers;
+
+    inline static Device* device;
+};
@@ -0,0 +1,37 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec3 sunDir;
+} ubo;
+
+// VertexLayout::Compact(): позиция уже переведена в координаты меша через ubo.model
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inNormalOct;
+layout(location = 2) in vec3 inColor;
+layout(location = 3) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec3 sunDir;
+layout(location = 3) out vec2 fragTexCoord;
+
+vec3 decodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main() {
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    fragColor = inColor;
+    fragNormal = decodeNormal(inNormalOct);
+
+    fragTexCoord = inTexCoord;
+
+    sunDir = ubo.sunDir;
+}
\ No newline at end of file
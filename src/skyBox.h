@@ -76,11 +76,10 @@ public:
     {
         glm::vec3 pos = camera->GetPosition();
         go->SetPosition(pos);
-        go->Update(deltaTime);
     }
 
     std::vector<Vertex> vertices;
-    std::vector<uint16_t> indices;
+    std::vector<uint32_t> indices;
 
     glm::vec3 colorTop;
     glm::vec3 colorBottom;
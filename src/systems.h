@@ -0,0 +1,281 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "registry.h"
+#include "components.h"
+#include "transform.h"
+#include "camera.h"
+#include "resource.h"
+#include "meshletRenderer.h"
+
+struct DrawPacket{
+    int layer;
+    Pipeline* pipeline;
+    uint32_t geometry;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    bool clustered;
+    uint32_t firstCommand;
+    uint32_t commandCount;
+};
+
+//Системы проходят по плотным массивам компонентов вместо обхода объектов через указатели
+class Systems{
+public:
+    static void Cull(Registry& registry, Camera* camera)
+    {
+        std::array<glm::vec4, 6> planes = ExtractFrustum(camera->proj * camera->view);
+
+        ComponentPool<BoundsComponent>& bounds = registry.Pool<BoundsComponent>();
+        ComponentPool<TransformComponent>& transforms = registry.Pool<TransformComponent>();
+        ComponentPool<RenderComponent>& renders = registry.Pool<RenderComponent>();
+        ComponentPool<TextureStreamComponent>& streams = registry.Pool<TextureStreamComponent>();
+
+        visibleCount = 0;
+
+        //Сколько пикселей экрана приходится на единицу длины на расстоянии 1
+        float pixelsPerUnit = Resource::swapChainExtent.height / (2.0f * std::tan(glm::radians(45.0f) * 0.5f));
+
+        for(size_t i = 0; i < bounds.dense.size(); i++)
+        {
+            EntityId entity = bounds.dense[i];
+
+            if(!renders.Has(entity) || !transforms.Has(entity))
+                continue;
+
+            const glm::mat4& world = Transforms::GetWorld(transforms.Get(entity).transform);
+
+            glm::vec3 center = glm::vec3(world * glm::vec4(bounds.components[i].center, 1.0f));
+            float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+            float radius = bounds.components[i].radius * scale;
+
+            bool visible = true;
+            for(auto& plane : planes)
+            {
+                if(glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                {
+                    visible = false;
+                    break;
+                }
+            }
+
+            RenderComponent& render = renders.Get(entity);
+
+            render.visible = visible;
+            if(!visible)
+                continue;
+
+            visibleCount++;
+
+            float distance = std::max(glm::length(center - camera->cameraPos) - radius, 0.001f);
+            render.lod = SelectLod(render.model->lods, render.lod, scale * pixelsPerUnit / distance);
+
+            if(streams.Has(entity))
+                RequestMip(*streams.Get(entity).texture, bounds.components[i].radius, scale * pixelsPerUnit / distance);
+        }
+    }
+
+    //Развёртка считается растянутой примерно на диаметр сферы: уровень, на котором
+    //тексель не мельче пикселя экрана
+    static void RequestMip(StreamedTexture& texture, float radius, float pixelsPerUnit)
+    {
+        if(!texture.IsLoaded())
+            return;
+
+        float texelsPerUnit = std::max(texture.GetWidth(), texture.GetHeight()) / std::max(2.0f * radius, 0.0001f);
+        float texelsPerPixel = texelsPerUnit / std::max(pixelsPerUnit, 0.0001f);
+
+        uint32_t level = texelsPerPixel > 1.0f ? static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel))) : 0;
+        texture.Request(std::min(level, texture.GetMipLevels() - 1));
+    }
+
+    //Самый грубый LOD, чья ошибка на экране укладывается в порог; гистерезис не даёт LOD дрожать на границе
+    static uint32_t SelectLod(const std::vector<ModelLod>& lods, uint32_t current, float pixelsPerUnit)
+    {
+        if(lods.size() <= 1)
+            return 0;
+
+        current = std::min<uint32_t>(current, static_cast<uint32_t>(lods.size() - 1));
+
+        uint32_t desired = 0;
+        for(uint32_t l = 1; l < lods.size(); l++)
+        {
+            if(lods[l].error * pixelsPerUnit <= LodThreshold)
+                desired = l;
+        }
+
+        if(desired > current)
+        {
+            if(lods[desired].error * pixelsPerUnit <= LodThreshold * (1.0f - LodHysteresis))
+                return desired;
+            return current;
+        }
+
+        if(desired < current)
+        {
+            if(lods[current].error * pixelsPerUnit > LodThreshold * (1.0f + LodHysteresis))
+                return desired;
+            return current;
+        }
+
+        return current;
+    }
+
+    //Буфер кадра переписывается, только если сменились мировая матрица, геометрия, камера или свет:
+    //статичная сцена при неподвижной камере обходится без записей
+    static void UpdateUniforms(Registry& registry, Camera* camera)
+    {
+        if(camera->view != lastView || camera->proj != lastProj)
+        {
+            lastView = camera->view;
+            lastProj = camera->proj;
+            cameraVersion++;
+        }
+
+        if(Resource::sunDir != lastSunDir)
+        {
+            lastSunDir = Resource::sunDir;
+            lightVersion++;
+        }
+
+        registry.Each<RenderComponent, TransformComponent>([camera](EntityId entity, RenderComponent& render, TransformComponent& transform){
+            if(!render.visible || render.sharedUniforms)
+                return;
+
+            WriteUniforms(*render.pipeline, transform.transform, render.model->dequantize, render.applyLight, camera);
+        });
+    }
+
+    static void WriteUniforms(Pipeline& pipeline, uint32_t transform, const glm::mat4& dequantize, bool applyLight, Camera* camera)
+    {
+        UniformStamp stamp{transform, Transforms::GetVersion(transform), cameraVersion, applyLight ? lightVersion : 0, dequantize};
+
+        UniformStamp& written = pipeline.uniformStamps[Resource::currentImage];
+        if(written == stamp)
+            return;
+
+        written = stamp;
+
+        UniformBufferObject ubo{};
+        ubo.model = Transforms::GetWorld(transform) * dequantize;
+        ubo.view = camera->view;
+        ubo.proj = camera->proj;
+
+        ubo.sunDir = applyLight ? Resource::sunDir : glm::vec3(1.0f, -3.0f, -1.0f);
+
+        memcpy(pipeline.uniformBuffersMapped[Resource::currentImage], &ubo, sizeof(ubo));
+    }
+
+    //Объекты на LOD0 с мешлетами рисуются кластерами через indirect-команды,
+    //остальные - одним vkCmdDrawIndexed на выбранный LOD
+    static void BuildDrawPackets(Registry& registry, Camera* camera, MeshletRenderer* meshlets, std::vector<DrawPacket>& packets)
+    {
+        packets.clear();
+
+        trianglesDrawn = 0;
+        trianglesFull = 0;
+
+        meshlets->BeginFrame();
+
+        registry.Each<RenderComponent, TransformComponent>([&](EntityId entity, RenderComponent& render, TransformComponent& transform){
+            if(!render.visible || !render.model->uploaded)
+                return;
+
+            const ModelLod& lod = render.model->lods[std::min<size_t>(render.lod, render.model->lods.size() - 1)];
+
+            trianglesDrawn += lod.indexCount / 3;
+            trianglesFull += render.model->lods[0].indexCount / 3;
+
+            if(render.lod == 0 && !render.model->meshlets.empty())
+            {
+                const GeometryAllocation& geometry = Model::pool->Get(render.model->geometry);
+
+                uint32_t firstCommand = meshlets->AddObject(Transforms::GetWorld(transform.transform), render.pipeline->face == VK_FRONT_FACE_COUNTER_CLOCKWISE,
+                                                            render.model->meshlets, geometry.firstIndex, geometry.vertexOffset);
+
+                packets.push_back({render.layer, render.pipeline, render.model->geometry, 0, 0, true, firstCommand, static_cast<uint32_t>(render.model->meshlets.size())});
+                return;
+            }
+
+            packets.push_back({render.layer, render.pipeline, render.model->geometry, lod.firstIndex, lod.indexCount, false, 0, 0});
+        });
+
+        meshlets->Upload(ExtractFrustum(camera->proj * camera->view), camera->cameraPos);
+
+        //Группируем по пайплайну и блоку геометрии, чтобы меньше переключать состояние
+        std::sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b){
+            if(a.layer != b.layer)
+                return a.layer < b.layer;
+            if(a.pipeline->graphicsPipeline != b.pipeline->graphicsPipeline)
+                return a.pipeline->graphicsPipeline < b.pipeline->graphicsPipeline;
+            return Model::pool->Get(a.geometry).block < Model::pool->Get(b.geometry).block;
+        });
+    }
+
+    static void Draw(VkCommandBuffer commandBuffer, int i, MeshletRenderer* meshlets, const std::vector<DrawPacket>& packets)
+    {
+        VkPipeline bound = VK_NULL_HANDLE;
+
+        for(auto& packet : packets)
+        {
+            if(packet.pipeline->graphicsPipeline != bound)
+            {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipeline->graphicsPipeline);
+                bound = packet.pipeline->graphicsPipeline;
+            }
+
+            const GeometryAllocation& geometry = Model::pool->Get(packet.geometry);
+
+            Model::pool->Bind(commandBuffer, geometry);
+
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipeline->pipelineLayout, 0, 1, &packet.pipeline->descriptorSets[i], 0, nullptr);
+
+            if(packet.clustered)
+            {
+                meshlets->Draw(commandBuffer, packet.firstCommand, packet.commandCount);
+                continue;
+            }
+
+            vkCmdDrawIndexed(commandBuffer, packet.indexCount, 1, geometry.firstIndex + packet.firstIndex, geometry.vertexOffset, 0);
+        }
+    }
+
+    //Плоскости в виде (n, d), нормали смотрят внутрь; глубина в диапазоне [0, 1]
+    static std::array<glm::vec4, 6> ExtractFrustum(const glm::mat4& m)
+    {
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        std::array<glm::vec4, 6> planes = {
+            row3 + row0,
+            row3 - row0,
+            row3 + row1,
+            row3 - row1,
+            row2,
+            row3 - row2
+        };
+
+        for(auto& plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+
+        return planes;
+    }
+
+    //Меняются, когда сдвинулась камера или солнце; входят в UniformStamp
+    inline static uint32_t cameraVersion = 1;
+    inline static uint32_t lightVersion = 1;
+    inline static glm::mat4 lastView = glm::mat4(0.0f);
+    inline static glm::mat4 lastProj = glm::mat4(0.0f);
+    inline static glm::vec3 lastSunDir = glm::vec3(0.0f);
+
+    inline static uint32_t visibleCount = 0;
+    inline static uint32_t trianglesDrawn = 0;
+    inline static uint32_t trianglesFull = 0;
+
+    //Допустимая ошибка LOD в пикселях и ширина гистерезиса в долях от неё
+    inline static float LodThreshold = 1.0f;
+    inline static float LodHysteresis = 0.25f;
+};
@@ -0,0 +1,321 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "gameObject.h"
+#include "jobPool.h"
+#include "registry.h"
+#include "components.h"
+#include "systems.h"
+#include "camera.h"
+
+#include <unordered_map>
+
+//Заявка на чанк: рабочий поток заполняет model, главный забирает её из очереди готовых
+struct TerrainJob{
+    glm::ivec3 coord;
+    std::atomic<bool> cancelled{false};
+    Model model{nullptr};
+};
+
+struct TerrainChunk{
+    glm::ivec3 coord;
+    std::shared_ptr<Model> model;
+    EntityId entity = NullEntity;
+    std::shared_ptr<TerrainJob> job;
+    bool queued = false;
+};
+
+//Ландшафт из чанков Tools::GetMCubes вокруг камеры. Чанки в радиусе radius строятся на своём
+//JobPool (сначала ближние, у каждого потока своя сетка плотности) и грузятся в пул геометрии
+//в Update не больше MaxUploadsPerFrame за кадр; выгружаются только
+//дальше radius + hysteresis, чтобы полёт вдоль границы не гонял одни и те же чанки.
+//Вершины чанков лежат в общих координатах ландшафта, поэтому все чанки делят один
+//пайплайн, одну матрицу и один набор дескрипторов
+class Terrain{
+public:
+    Terrain(Device* device, Camera* camera, Registry* registry)
+    {
+        this->device = device;
+        this->camera = camera;
+        this->registry = registry;
+
+        scratch.resize(pool.GetThreadCount());
+
+        //Держатель пайплайна и трансформа; своей геометрии у него нет
+        go = new GameObject(device, camera);
+        if(Vfs::Exists("shaders/nTVert.spv") && Vfs::Exists("shaders/nTFrag.spv"))
+            go->SetShadersName("shaders/nTVert.spv", "shaders/nTFrag.spv");
+        else
+        {
+            go->SetShadersName("shaders/vert.spv", "shaders/frag.spv");
+            go->SetTexture(Entity::assets->GetPlaceholderTexture());
+        }
+        go->SetSize(glm::vec3(0.1f));
+        go->applyLight = true;
+        go->Init();
+    }
+    ~Terrain()
+    {
+        for(auto& [key, chunk] : chunks)
+            unload(chunk);
+
+        delete go;
+    }
+
+    //Главный поток, раз в кадр после обновления камеры
+    void Update()
+    {
+        glm::ivec3 center = chunkAt(camera->GetPosition());
+
+        if(center != lastCenter || chunks.empty())
+        {
+            lastCenter = center;
+            refresh(center);
+        }
+
+        dispatch();
+        collect();
+    }
+
+    //После Systems::UpdateUniforms: одна запись за все чанки вместо записи на каждый видимый.
+    //Чанки в полной раскладке, так что dequantize у всех единичная
+    void UpdateUniforms()
+    {
+        if(meshedCount > 0)
+            Systems::WriteUniforms(*go->pipeline, go->transform, glm::mat4(1.0f), go->applyLight, camera);
+    }
+
+    size_t GetChunkCount() const { return chunks.size(); }
+    uint32_t GetMeshedCount() const { return meshedCount; }
+    uint32_t GetInFlight() const { return inFlight; }
+    //Чанков, построенных за последнюю секунду
+    uint32_t GetBuildRate() const { return buildRate; }
+    uint32_t GetThreadCount() const { return pool.GetThreadCount(); }
+
+    GameObject* go;
+
+    //В чанках по XZ; меняется до первого Update
+    int radius = 8;
+    int hysteresis = 2;
+
+    //Заявок в пуле на поток: при быстром полёте очередь не забивается чанками, которые уже позади
+    inline static const uint32_t JobsPerThread = 2;
+    inline static const uint32_t MaxUploadsPerFrame = 4;
+    //Высота рельефа MakeMCubes укладывается в два слоя чанков
+    inline static const int HeightChunks = 2;
+
+private:
+    //Координаты чанка (по 21 бит со знаком) в одном ключе
+    static uint64_t chunkKey(const glm::ivec3& coord)
+    {
+        const uint64_t Mask = (1ull << 21) - 1;
+        return ((uint64_t(coord.x) & Mask) << 42) | ((uint64_t(coord.y) & Mask) << 21) | (uint64_t(coord.z) & Mask);
+    }
+
+    static glm::ivec3 chunkAt(const glm::vec3& position)
+    {
+        return glm::ivec3(static_cast<int>(std::floor(position.x / Tools::ChunkSize)), 0, static_cast<int>(std::floor(position.z / Tools::ChunkSize)));
+    }
+
+    static int distance2(const glm::ivec3& a, const glm::ivec3& b)
+    {
+        int dx = a.x - b.x;
+        int dz = a.z - b.z;
+        return dx * dx + dz * dz;
+    }
+
+    void refresh(const glm::ivec3& center)
+    {
+        int unloadRadius = radius + hysteresis;
+
+        for(auto it = chunks.begin(); it != chunks.end();)
+        {
+            if(distance2(it->second.coord, center) > unloadRadius * unloadRadius)
+            {
+                unload(it->second);
+                it = chunks.erase(it);
+            }
+            else
+                ++it;
+        }
+
+        for(int dx = -radius; dx <= radius; dx++)
+            for(int dz = -radius; dz <= radius; dz++)
+            {
+                if(dx * dx + dz * dz > radius * radius)
+                    continue;
+
+                for(int y = 0; y < HeightChunks; y++)
+                {
+                    glm::ivec3 coord(center.x + dx, y, center.z + dz);
+                    uint64_t key = chunkKey(coord);
+
+                    if(chunks.count(key))
+                        continue;
+
+                    TerrainChunk& chunk = chunks[key];
+                    chunk.coord = coord;
+                    chunk.queued = true;
+                    queue.push_back(coord);
+                }
+            }
+
+        //Ближние в конце: берутся через pop_back
+        std::sort(queue.begin(), queue.end(), [&center](const glm::ivec3& a, const glm::ivec3& b){
+            return distance2(a, center) > distance2(b, center);
+        });
+    }
+
+    void dispatch()
+    {
+        uint32_t maxInFlight = pool.GetThreadCount() * JobsPerThread;
+
+        while(inFlight < maxInFlight && !queue.empty())
+        {
+            glm::ivec3 coord = queue.back();
+            queue.pop_back();
+
+            auto it = chunks.find(chunkKey(coord));
+            if(it == chunks.end() || !it->second.queued)
+                continue;
+
+            it->second.queued = false;
+            it->second.job = build(coord);
+            inFlight++;
+        }
+    }
+
+    //Готовые чанки в пул геометрии; отменённые только снимаются со счёта
+    void collect()
+    {
+        std::vector<std::shared_ptr<TerrainJob>> ready;
+
+        {
+            std::lock_guard<std::mutex> lock(doneMutex);
+
+            size_t count = std::min(done.size(), static_cast<size_t>(MaxUploadsPerFrame));
+            ready.assign(done.begin(), done.begin() + count);
+            done.erase(done.begin(), done.begin() + count);
+        }
+
+        for(auto& job : ready)
+        {
+            inFlight--;
+
+            if(job->cancelled)
+                continue;
+
+            auto it = chunks.find(chunkKey(job->coord));
+            if(it != chunks.end() && it->second.job == job)
+                upload(it->second, job->model);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if(now - rateStart >= std::chrono::seconds(1))
+        {
+            buildRate = builtCount.exchange(0);
+            rateStart = now;
+        }
+    }
+
+    std::shared_ptr<TerrainJob> build(const glm::ivec3& coord)
+    {
+        auto job = std::make_shared<TerrainJob>();
+        job->coord = coord;
+
+        pool.Submit([this, job](uint32_t worker){
+            if(!job->cancelled)
+            {
+                generate(job->coord, scratch[worker], job->model);
+                builtCount++;
+            }
+
+            std::lock_guard<std::mutex> lock(doneMutex);
+            done.push_back(job);
+        }, static_cast<float>(distance2(coord, lastCenter)));
+
+        return job;
+    }
+
+    //Рабочий поток. LOD и перестановки под кэш строятся здесь же, Init их только загружает;
+    //открытые края чанка MeshSimplifier не трогает, так что LOD соседей сходятся на стыках
+    static void generate(const glm::ivec3& coord, MCubesScratch& scratch, Model& model)
+    {
+        PrimitiveObject object = Tools::GetMCubes(glm::vec3(coord), scratch);
+
+        glm::vec3 origin = glm::vec3(coord) * static_cast<float>(Tools::ChunkSize);
+        for(auto& vertex : object.vertices)
+            vertex.pos += origin;
+
+        model.vertices = std::move(object.vertices);
+        model.indices = std::move(object.indices);
+
+        if(!model.indices.empty())
+            model.Optimize(false);
+
+        model.ComputeBounds();
+    }
+
+    void upload(TerrainChunk& chunk, Model& source)
+    {
+        chunk.job.reset();
+
+        //Чанк целиком над или под поверхностью - запись остаётся, чтобы не строить его снова
+        if(source.indices.empty())
+            return;
+
+        chunk.model = DeletionQueue::MakeShared(new Model(device));
+        chunk.model->TakeGeometry(source);
+        chunk.model->Init();
+
+        chunk.entity = registry->Create();
+        registry->Add<TransformComponent>(chunk.entity, {go->transform});
+        registry->Add<RenderComponent>(chunk.entity, {chunk.model.get(), go->pipeline, go->applyLight, go->layer, true, 0, true});
+        registry->Add<BoundsComponent>(chunk.entity, {chunk.model->boundsCenter, chunk.model->boundsRadius});
+
+        meshedCount++;
+    }
+
+    //Геометрия уходит через DeletionQueue, когда её не читает ни один кадр
+    void unload(TerrainChunk& chunk)
+    {
+        //Поток ещё вернёт заявку в done, там она и снимется со счёта
+        if(chunk.job)
+            chunk.job->cancelled = true;
+
+        if(chunk.entity != NullEntity)
+        {
+            registry->Destroy(chunk.entity);
+            meshedCount--;
+        }
+
+        chunk.model.reset();
+    }
+
+    //Разреженная карта по ключу координат: память только под чанки вокруг камеры
+    std::unordered_map<uint64_t, TerrainChunk> chunks;
+    std::vector<glm::ivec3> queue;
+
+    glm::ivec3 lastCenter{0};
+
+    uint32_t inFlight = 0;
+    uint32_t meshedCount = 0;
+
+    std::atomic<uint32_t> builtCount{0};
+    uint32_t buildRate = 0;
+    std::chrono::steady_clock::time_point rateStart = std::chrono::steady_clock::now();
+
+    Device* device;
+    Camera* camera;
+    Registry* registry;
+
+    //Индекс - номер потока пула
+    std::vector<MCubesScratch> scratch;
+
+    std::mutex doneMutex;
+    std::vector<std::shared_ptr<TerrainJob>> done;
+
+    //Последним членом: разрушается первым и дожидается рабочих потоков, пока остальное ещё живо
+    JobPool pool;
+};
@@ -0,0 +1,391 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "device.h"
+#include "tools.h"
+#include "textureCompressor.h"
+#include "samplerCache.h"
+#include "deletionQueue.h"
+
+//Картинка в GPU вместе с видом; сэмплер общий из SamplerCache. Один объект может делиться
+//между несколькими пайплайнами через AssetCache, поэтому пайплайн только ссылается на view/sampler
+class Texture{
+public:
+    Texture(Device* device)
+    {
+        this->device = device;
+    }
+    ~Texture()
+    {
+        //Отложенная загрузка так и не была записана
+        if(pendingBuffer != VK_NULL_HANDLE)
+        {
+            vkDestroyBuffer(device->device, pendingBuffer, nullptr);
+            vkFreeMemory(device->device, pendingMemory, nullptr);
+        }
+        if(view != VK_NULL_HANDLE)
+            vkDestroyImageView(device->device, view, nullptr);
+        if(image != VK_NULL_HANDLE)
+        {
+            vkDestroyImage(device->device, image, nullptr);
+            vkFreeMemory(device->device, memory, nullptr);
+        }
+    }
+
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+
+    //RGBA8, sRGB, с полной цепочкой мип-уровней
+    void Create(const uint8_t* pixels, int texWidth, int texHeight)
+    {
+        width = static_cast<uint32_t>(texWidth);
+        height = static_cast<uint32_t>(texHeight);
+        mipLevels = GetMipLevels(width, height);
+
+        createTextureImage(pixels, texWidth, texHeight);
+        createTextureImageView();
+        createTextureSampler();
+    }
+
+    //Готовая цепочка уровней (BC или RGBA8), грузится одним vkCmdCopyBufferToImage на все уровни
+    //baseLevel > 0 - только уровни начиная с него (стриминг держит в памяти хвост цепочки)
+    void Create(const CompressedTexture& compressed, uint32_t baseLevel = 0)
+    {
+        baseLevel = std::min(baseLevel, compressed.mipLevels - 1);
+
+        width = std::max(compressed.width >> baseLevel, 1u);
+        height = std::max(compressed.height >> baseLevel, 1u);
+        mipLevels = compressed.mipLevels - baseLevel;
+        format = compressed.format;
+
+        createCompressedImage(compressed, baseLevel);
+        createTextureImageView();
+        createTextureSampler();
+    }
+
+    //То же, но копирование в картинку не отправляется сразу, а записывается RecordUpload
+    //в буфер команд кадра: главный поток не ждёт очередь. До RecordUpload текстура не читается
+    void CreateDeferred(const CompressedTexture& compressed, uint32_t baseLevel = 0)
+    {
+        baseLevel = std::min(baseLevel, compressed.mipLevels - 1);
+
+        width = std::max(compressed.width >> baseLevel, 1u);
+        height = std::max(compressed.height >> baseLevel, 1u);
+        mipLevels = compressed.mipLevels - baseLevel;
+        format = compressed.format;
+
+        stageCompressedImage(compressed, baseLevel);
+        createTextureImageView();
+        createTextureSampler();
+    }
+
+    //До начала render pass; буфер-источник удаляется, когда кадр с копированием завершится
+    void RecordUpload(VkCommandBuffer commandBuffer)
+    {
+        if(pendingBuffer == VK_NULL_HANDLE)
+            return;
+
+        recordCompressedUpload(commandBuffer);
+
+        VkBuffer buffer = pendingBuffer;
+        VkDeviceMemory bufferMemory = pendingMemory;
+        Device* owner = device;
+        DeletionQueue::Push([owner, buffer, bufferMemory]{
+            vkDestroyBuffer(owner->device, buffer, nullptr);
+            vkFreeMemory(owner->device, bufferMemory, nullptr);
+        });
+
+        pendingBuffer = VK_NULL_HANDLE;
+        pendingMemory = VK_NULL_HANDLE;
+        pendingRegions.clear();
+    }
+
+    //Обмен картинками с другой текстурой: так текстура подменяется на месте для всех, кто её
+    //держит, а старые хэндлы уходят вместе с other (её удаляют через DeletionQueue)
+    void Swap(Texture& other)
+    {
+        std::swap(image, other.image);
+        std::swap(memory, other.memory);
+        std::swap(view, other.view);
+        std::swap(sampler, other.sampler);
+        std::swap(width, other.width);
+        std::swap(height, other.height);
+        std::swap(mipLevels, other.mipLevels);
+        std::swap(format, other.format);
+    }
+
+    static uint32_t GetMipLevels(uint32_t width, uint32_t height)
+    {
+        uint32_t levels = 1;
+        while((std::max(width, height) >> levels) > 0)
+            levels++;
+
+        return levels;
+    }
+
+    //Для vkCmdBlitImage с линейной фильтрацией формат должен это поддерживать в optimal tiling
+    static bool CanBlit(VkFormat format)
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(Tools::device->physicalDevice, format, &properties);
+
+        VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        return (properties.optimalTilingFeatures & required) == required;
+    }
+
+    void createTextureImage(const uint8_t* pixels, int texWidth, int texHeight) {
+        bool gpuMips = mipLevels == 1 || CanBlit(format);
+
+        //Без поддержки blit уровни считаются на CPU и грузятся одним копированием
+        std::vector<VkBufferImageCopy> regions;
+        std::vector<uint8_t> levels;
+        if(gpuMips)
+            regions.push_back(levelRegion(0, 0));
+        else
+            buildMipsOnCpu(pixels, levels, regions);
+
+        VkDeviceSize imageSize = gpuMips ? static_cast<VkDeviceSize>(texWidth) * texHeight * 4 : levels.size();
+
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        Tools::createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+        void* data;
+        vkMapMemory(device->device, stagingBufferMemory, 0, imageSize, 0, &data);
+            memcpy(data, gpuMips ? pixels : levels.data(), static_cast<size_t>(imageSize));
+        vkUnmapMemory(device->device, stagingBufferMemory);
+
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        if(gpuMips && mipLevels > 1)
+            usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+        Tools::createImage(texWidth, texHeight, format, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory, mipLevels);
+
+        VkCommandBuffer commandBuffer = Tools::beginSingleTimeCommands();
+
+        transitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, mipLevels);
+
+        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+        if(gpuMips)
+            generateMipmaps(commandBuffer);
+        else
+            transitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, mipLevels);
+
+        Tools::endSingleTimeCommands(commandBuffer);
+
+        vkDestroyBuffer(device->device, stagingBuffer, nullptr);
+        vkFreeMemory(device->device, stagingBufferMemory, nullptr);
+
+    }
+
+    void createCompressedImage(const CompressedTexture& compressed, uint32_t baseLevel) {
+        stageCompressedImage(compressed, baseLevel);
+
+        VkCommandBuffer commandBuffer = Tools::beginSingleTimeCommands();
+        recordCompressedUpload(commandBuffer);
+        Tools::endSingleTimeCommands(commandBuffer);
+
+        vkDestroyBuffer(device->device, pendingBuffer, nullptr);
+        vkFreeMemory(device->device, pendingMemory, nullptr);
+
+        pendingBuffer = VK_NULL_HANDLE;
+        pendingMemory = VK_NULL_HANDLE;
+        pendingRegions.clear();
+    }
+
+    //Уровни в буфер-источник и пустая картинка под них; копирование - recordCompressedUpload
+    void stageCompressedImage(const CompressedTexture& compressed, uint32_t baseLevel) {
+        VkDeviceSize first = compressed.offsets[baseLevel];
+        VkDeviceSize imageSize = compressed.GetSize() - first;
+
+        Tools::createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, pendingBuffer, pendingMemory);
+
+        void* data;
+        vkMapMemory(device->device, pendingMemory, 0, imageSize, 0, &data);
+            memcpy(data, compressed.GetData() + first, static_cast<size_t>(imageSize));
+        vkUnmapMemory(device->device, pendingMemory);
+
+        Tools::createImage(width, height, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory, mipLevels);
+
+        pendingRegions.clear();
+        for(uint32_t i = 0; i < mipLevels; i++)
+            pendingRegions.push_back(levelRegion(i, compressed.offsets[baseLevel + i] - first));
+    }
+
+    void recordCompressedUpload(VkCommandBuffer commandBuffer) {
+        transitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, mipLevels);
+        vkCmdCopyBufferToImage(commandBuffer, pendingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(pendingRegions.size()), pendingRegions.data());
+        transitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, mipLevels);
+    }
+
+    //Каждый уровень получается из предыдущего: уровень i-1 переводится в TRANSFER_SRC,
+    //уменьшается в i и сразу отдаётся шейдеру
+    void generateMipmaps(VkCommandBuffer commandBuffer) {
+        int32_t mipWidth = static_cast<int32_t>(width);
+        int32_t mipHeight = static_cast<int32_t>(height);
+
+        for(uint32_t i = 1; i < mipLevels; i++)
+        {
+            transitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, i - 1, 1);
+
+            int32_t nextWidth = std::max(mipWidth / 2, 1);
+            int32_t nextHeight = std::max(mipHeight / 2, 1);
+
+            VkImageBlit blit{};
+            blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.srcSubresource.mipLevel = i - 1;
+            blit.srcSubresource.baseArrayLayer = 0;
+            blit.srcSubresource.layerCount = 1;
+            blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.dstSubresource.mipLevel = i;
+            blit.dstSubresource.baseArrayLayer = 0;
+            blit.dstSubresource.layerCount = 1;
+
+            vkCmdBlitImage(commandBuffer,
+                image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                1, &blit,
+                VK_FILTER_LINEAR);
+
+            transitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, i - 1, 1);
+
+            mipWidth = nextWidth;
+            mipHeight = nextHeight;
+        }
+
+        transitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels - 1, 1);
+    }
+
+    //Все уровни подряд в одном буфере, уменьшение с учётом sRGB
+    void buildMipsOnCpu(const uint8_t* pixels, std::vector<uint8_t>& levels, std::vector<VkBufferImageCopy>& regions) {
+        size_t total = 0;
+        for(uint32_t i = 0; i < mipLevels; i++)
+            total += static_cast<size_t>(std::max(width >> i, 1u)) * std::max(height >> i, 1u) * 4;
+
+        levels.resize(total);
+        memcpy(levels.data(), pixels, static_cast<size_t>(width) * height * 4);
+
+        size_t offset = 0;
+        for(uint32_t i = 0; i < mipLevels; i++)
+        {
+            regions.push_back(levelRegion(i, offset));
+
+            if(i > 0)
+            {
+                size_t previous = regions[i - 1].bufferOffset;
+                stbir_resize_uint8_srgb(levels.data() + previous, std::max(width >> (i - 1), 1u), std::max(height >> (i - 1), 1u), 0,
+                                        levels.data() + offset, std::max(width >> i, 1u), std::max(height >> i, 1u), 0,
+                                        4, 3, 0);
+            }
+
+            offset += static_cast<size_t>(std::max(width >> i, 1u)) * std::max(height >> i, 1u) * 4;
+        }
+    }
+
+    VkBufferImageCopy levelRegion(uint32_t level, VkDeviceSize offset) {
+        VkBufferImageCopy region{};
+        region.bufferOffset = offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {std::max(width >> level, 1u), std::max(height >> level, 1u), 1};
+
+        return region;
+    }
+
+    void createTextureImageView() {
+        view = Tools::createImageView(image, format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+    }
+
+    //Сэмплер общий из SamplerCache, Texture им не владеет
+    void createTextureSampler() {
+        sampler = SamplerCache::Get(samplerState);
+    }
+
+    //Барьер для уровней [baseMip, baseMip + levelCount) внутри уже начатого буфера команд
+    static void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMip, uint32_t levelCount) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = baseMip;
+        barrier.subresourceRange.levelCount = levelCount;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        VkPipelineStageFlags sourceStage;
+        VkPipelineStageFlags destinationStage;
+
+        if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        } else {
+            throw std::invalid_argument("unsupported layout transition!");
+        }
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            sourceStage, destinationStage,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier
+        );
+    }
+
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipLevels = 1;
+
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+
+    //Задаётся до Create
+    SamplerState samplerState;
+
+    //Уровни, ждущие копирования в image (createCompressedImage / CreateDeferred)
+    VkBuffer pendingBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory pendingMemory = VK_NULL_HANDLE;
+    std::vector<VkBufferImageCopy> pendingRegions;
+
+    Device* device;
+};
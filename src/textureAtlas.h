@@ -0,0 +1,180 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <stb_rect_pack.h>
+
+//Где картинка лежит в атласе: texCoord * scale + offset
+struct AtlasRegion{
+    uint32_t page = 0;
+    glm::vec2 offset = glm::vec2(0.0f);
+    glm::vec2 scale = glm::vec2(1.0f);
+};
+
+//Страница атласа, RGBA8
+struct AtlasPage{
+    std::vector<uint8_t> pixels;
+    uint32_t size = 0;
+};
+
+//Собирает маленькие картинки в страницы атласа через stb_rect_pack. Вокруг каждой картинки -
+//поле из повторённых краевых пикселей, а углы выровнены на Alignment, чтобы соседи не
+//смешивались ни при билинейной выборке, ни на первых мип-уровнях
+class TextureAtlas{
+public:
+    TextureAtlas(uint32_t pageSize = 1024, uint32_t padding = 4)
+    {
+        this->pageSize = pageSize;
+        this->padding = padding;
+    }
+
+    //Копирует картинку; возвращает номер для GetRegion
+    uint32_t Add(const uint8_t* pixels, uint32_t width, uint32_t height)
+    {
+        Entry entry;
+        entry.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+        entry.width = width;
+        entry.height = height;
+
+        entries.push_back(std::move(entry));
+        return static_cast<uint32_t>(entries.size() - 1);
+    }
+
+    //false, если какая-то картинка с полем не влезает в страницу
+    bool Build()
+    {
+        uint32_t cells = pageSize / Alignment;
+
+        std::vector<stbrp_rect> rects(entries.size());
+        for(size_t i = 0; i < entries.size(); i++)
+        {
+            rects[i].id = static_cast<int>(i);
+            rects[i].w = (entries[i].width + padding * 2 + Alignment - 1) / Alignment;
+            rects[i].h = (entries[i].height + padding * 2 + Alignment - 1) / Alignment;
+            rects[i].was_packed = 0;
+
+            if((uint32_t)rects[i].w > cells || (uint32_t)rects[i].h > cells)
+                return false;
+        }
+
+        pages.clear();
+        std::vector<stbrp_node> nodes(cells);
+
+        //Упаковываем в ячейки Alignment x Alignment; что не влезло - на следующую страницу
+        while(!rects.empty())
+        {
+            stbrp_context context;
+            stbrp_init_target(&context, cells, cells, nodes.data(), static_cast<int>(nodes.size()));
+            stbrp_pack_rects(&context, rects.data(), static_cast<int>(rects.size()));
+
+            AtlasPage page;
+            page.size = pageSize;
+            page.pixels.assign(static_cast<size_t>(pageSize) * pageSize * 4, 0);
+
+            uint32_t pageIndex = static_cast<uint32_t>(pages.size());
+            std::vector<stbrp_rect> rest;
+
+            for(auto& rect : rects)
+            {
+                if(!rect.was_packed)
+                {
+                    rest.push_back(rect);
+                    continue;
+                }
+
+                Entry& entry = entries[rect.id];
+                uint32_t x = rect.x * Alignment + padding;
+                uint32_t y = rect.y * Alignment + padding;
+
+                blit(page, entry, x, y);
+
+                entry.region.page = pageIndex;
+                entry.region.offset = glm::vec2(x, y) / (float)pageSize;
+                entry.region.scale = glm::vec2(entry.width, entry.height) / (float)pageSize;
+            }
+
+            pages.push_back(std::move(page));
+
+            if(rest.size() == rects.size())
+                return false;
+
+            rects = std::move(rest);
+        }
+
+        for(auto& entry : entries)
+        {
+            entry.pixels.clear();
+            entry.pixels.shrink_to_fit();
+        }
+
+        return true;
+    }
+
+    const AtlasRegion& GetRegion(uint32_t index) const
+    {
+        return entries[index].region;
+    }
+
+    //Сколько мип-уровней можно строить, чтобы поле не исчезло: на уровне L от него остаётся padding >> L
+    uint32_t GetMipLevels() const
+    {
+        uint32_t levels = 1;
+        while((std::min(padding, Alignment) >> levels) > 0)
+            levels++;
+
+        return levels;
+    }
+
+    //Атлас не повторяет картинку, поэтому подходят только развёртки внутри [0, 1]
+    static bool FitsAtlas(const std::vector<Vertex>& vertices)
+    {
+        for(auto& vertex : vertices)
+            if(vertex.texCoord.x < 0.0f || vertex.texCoord.x > 1.0f || vertex.texCoord.y < 0.0f || vertex.texCoord.y > 1.0f)
+                return false;
+
+        return true;
+    }
+
+    static void RemapTexCoords(std::vector<Vertex>& vertices, const AtlasRegion& region)
+    {
+        for(auto& vertex : vertices)
+            vertex.texCoord = vertex.texCoord * region.scale + region.offset;
+    }
+
+    std::vector<AtlasPage> pages;
+
+    inline static const uint32_t Alignment = 4;
+
+private:
+    struct Entry{
+        std::vector<uint8_t> pixels;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        AtlasRegion region;
+    };
+
+    //Картинка в (x, y), поле заполняется ближайшим краевым пикселем
+    void blit(AtlasPage& page, const Entry& entry, uint32_t x, uint32_t y)
+    {
+        int32_t left = static_cast<int32_t>(x) - static_cast<int32_t>(padding);
+        int32_t top = static_cast<int32_t>(y) - static_cast<int32_t>(padding);
+        int32_t right = std::min<int32_t>(x + entry.width + padding, pageSize);
+        int32_t bottom = std::min<int32_t>(y + entry.height + padding, pageSize);
+
+        for(int32_t py = top; py < bottom; py++)
+            for(int32_t px = left; px < right; px++)
+            {
+                int32_t sx = std::clamp<int32_t>(px - static_cast<int32_t>(x), 0, entry.width - 1);
+                int32_t sy = std::clamp<int32_t>(py - static_cast<int32_t>(y), 0, entry.height - 1);
+
+                memcpy(page.pixels.data() + (static_cast<size_t>(py) * pageSize + px) * 4,
+                       entry.pixels.data() + (static_cast<size_t>(sy) * entry.width + sx) * 4, 4);
+            }
+    }
+
+    std::vector<Entry> entries;
+
+    uint32_t pageSize;
+    uint32_t padding;
+};
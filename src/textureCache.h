@@ -0,0 +1,145 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "meshCache.h"
+#include "textureCompressor.h"
+
+//До 32768x32768
+const uint32_t TextureCacheMaxLevels = 16;
+
+//Заголовок файла .tex; после него (с выравниванием на 16 байт) уровни подряд, от большего к меньшему
+struct TextureCacheHeader{
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+
+    //Сжаты ли уровни в BC при сборке (AssetLoader::compressTextures)
+    uint8_t blockCompressed;
+    //0 - уровни лежат как есть; место под сжатие поверх BC
+    uint8_t supercompression;
+    uint8_t padding[6];
+
+    uint64_t levelOffsets[TextureCacheMaxLevels];
+    uint64_t levelSizes[TextureCacheMaxLevels];
+};
+
+//Готовая к загрузке текстура: формат, все мип-уровни, уже сжатые. При чтении файл отображается
+//в память, и уровни одним копированием идут в staging-буфер без декодирования картинки
+class TextureCache{
+public:
+    inline static const uint32_t Version = 1;
+
+    static std::string GetPath(const std::string& sourcePath)
+    {
+        return sourcePath + ".tex";
+    }
+
+    static bool Load(const std::string& path, uint64_t sourceHash, bool blockCompressed, CompressedTexture& texture)
+    {
+        auto file = std::make_shared<MappedFile>();
+        if(!Vfs::Open(path, *file) || file->GetSize() < sizeof(TextureCacheHeader))
+            return false;
+
+        TextureCacheHeader header;
+        memcpy(&header, file->GetData(), sizeof(header));
+
+        if(memcmp(header.magic, "VTTX", 4) != 0 || header.version != Version || header.sourceHash != sourceHash ||
+           header.supercompression != 0 || (header.blockCompressed != 0) != blockCompressed)
+            return false;
+
+        VkFormat format = (VkFormat)header.format;
+        if(TextureCompressor::IsBlockCompressed(format) && !TextureCompressor::IsSupported(format))
+            return false;
+
+        if(header.mipLevels == 0 || header.mipLevels > TextureCacheMaxLevels)
+            return false;
+
+        //Уровни идут подряд: первый сразу после заголовка, последний кончается в конце данных
+        uint64_t begin = header.levelOffsets[0];
+        uint64_t end = header.levelOffsets[header.mipLevels - 1] + header.levelSizes[header.mipLevels - 1];
+        if(begin < sizeof(TextureCacheHeader) || end > file->GetSize())
+            return false;
+
+        texture.format = format;
+        texture.width = header.width;
+        texture.height = header.height;
+        texture.mipLevels = header.mipLevels;
+        texture.data.clear();
+        texture.offsets.clear();
+
+        for(uint32_t i = 0; i < header.mipLevels; i++)
+        {
+            uint32_t levelWidth = std::max(header.width >> i, 1u);
+            uint32_t levelHeight = std::max(header.height >> i, 1u);
+
+            if(header.levelOffsets[i] < begin || header.levelOffsets[i] + header.levelSizes[i] > end ||
+               header.levelSizes[i] != TextureCompressor::GetLevelSize(format, levelWidth, levelHeight))
+                return false;
+
+            texture.offsets.push_back(header.levelOffsets[i] - begin);
+        }
+
+        texture.mapped = file->GetData() + begin;
+        texture.mappedSize = end - begin;
+        texture.file = file;
+
+        return true;
+    }
+
+    static bool Save(const std::string& path, uint64_t sourceHash, bool blockCompressed, const CompressedTexture& texture)
+    {
+        if(texture.mipLevels == 0 || texture.mipLevels > TextureCacheMaxLevels)
+            return false;
+
+        TextureCacheHeader header{};
+        memcpy(header.magic, "VTTX", 4);
+        header.version = Version;
+        header.sourceHash = sourceHash;
+
+        header.format = (uint32_t)texture.format;
+        header.width = texture.width;
+        header.height = texture.height;
+        header.mipLevels = texture.mipLevels;
+        header.blockCompressed = blockCompressed;
+        header.supercompression = 0;
+
+        //Уровни в файле лежат так же, как в буфере, со сдвигом на заголовок
+        uint64_t begin = align(sizeof(TextureCacheHeader));
+        for(uint32_t i = 0; i < texture.mipLevels; i++)
+        {
+            header.levelOffsets[i] = begin + texture.offsets[i];
+            header.levelSizes[i] = TextureCompressor::GetLevelSize(texture.format, std::max(texture.width >> i, 1u), std::max(texture.height >> i, 1u));
+        }
+
+        std::vector<uint8_t> data(begin + texture.GetSize(), 0);
+        memcpy(data.data(), &header, sizeof(header));
+        memcpy(data.data() + begin, texture.GetData(), texture.GetSize());
+
+        //Пишем во временный файл и подменяем, чтобы оборванная запись не оставила битый кэш
+        std::string temp = path + ".tmp";
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if(!file)
+                return false;
+
+            file.write(reinterpret_cast<const char*>(data.data()), data.size());
+            if(!file)
+                return false;
+        }
+
+        std::remove(path.c_str());
+        return std::rename(temp.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 15) & ~uint64_t(15);
+    }
+};
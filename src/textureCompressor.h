@@ -0,0 +1,295 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+#include "mappedFile.h"
+
+#include <memory>
+#include <thread>
+
+//Назначение текстуры определяет формат сжатия: цвет - BC1/BC3, маска - BC4, нормали - BC5
+enum class TextureUsage{
+    Color,
+    Mask,
+    Normal
+};
+
+//Все мип-уровни одного формата (BC или RGBA8) подряд в одном буфере. Уровни лежат либо
+//в data, либо прямо в отображённом файле .tex (file)
+struct CompressedTexture{
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipLevels = 0;
+
+    std::vector<uint8_t> data;
+    std::vector<VkDeviceSize> offsets;
+
+    std::shared_ptr<MappedFile> file;
+    const uint8_t* mapped = nullptr;
+    size_t mappedSize = 0;
+
+    const uint8_t* GetData() const { return mapped ? mapped : data.data(); }
+    size_t GetSize() const { return mapped ? mappedSize : data.size(); }
+
+    bool IsValid() const { return format != VK_FORMAT_UNDEFINED && GetSize() > 0; }
+};
+
+//Сжатие RGBA8 в блочные форматы BC с помощью stb_dxt. Блоки 4x4 независимы,
+//поэтому строки блоков кодируются параллельно
+class TextureCompressor{
+public:
+    //Один раз после создания устройства: какие форматы BC можно сэмплировать
+    static void Init(VkPhysicalDevice physicalDevice)
+    {
+        for(int i = 0; i < FormatCount; i++)
+        {
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, formats[i], &properties);
+
+            VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+            supported[i] = (properties.optimalTilingFeatures & required) == required;
+        }
+    }
+
+    static bool IsSupported(VkFormat format)
+    {
+        for(int i = 0; i < FormatCount; i++)
+            if(formats[i] == format)
+                return supported[i];
+
+        return false;
+    }
+
+    //По имени файла: *_n, *_normal - нормали, *_mask, *_rough, *_metal, *_ao, *_height - маски
+    static TextureUsage GuessUsage(const std::string& path)
+    {
+        std::string name = path.substr(0, path.find_last_of('.'));
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c){ return std::tolower(c); });
+
+        auto endsWith = [&](const char* suffix){
+            size_t length = strlen(suffix);
+            return name.size() >= length && name.compare(name.size() - length, length, suffix) == 0;
+        };
+
+        if(endsWith("_n") || endsWith("_normal") || endsWith("_nrm"))
+            return TextureUsage::Normal;
+        if(endsWith("_mask") || endsWith("_rough") || endsWith("_roughness") || endsWith("_metal") || endsWith("_metallic") || endsWith("_ao") || endsWith("_height"))
+            return TextureUsage::Mask;
+
+        return TextureUsage::Color;
+    }
+
+    static VkFormat ChooseFormat(const uint8_t* pixels, uint32_t width, uint32_t height, TextureUsage usage)
+    {
+        switch(usage)
+        {
+            case TextureUsage::Normal:
+                return VK_FORMAT_BC5_UNORM_BLOCK;
+            case TextureUsage::Mask:
+                return VK_FORMAT_BC4_UNORM_BLOCK;
+            default:
+                break;
+        }
+
+        size_t count = static_cast<size_t>(width) * height;
+        for(size_t i = 0; i < count; i++)
+            if(pixels[i * 4 + 3] != 255)
+                return VK_FORMAT_BC3_SRGB_BLOCK;
+
+        return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    }
+
+    //Строит мип-цепочку и сжимает каждый уровень. false, если формат не поддерживается -
+    //тогда текстура грузится несжатой
+    //maxLevels = 0 - вся цепочка до 1x1
+    static bool Compress(const uint8_t* pixels, uint32_t width, uint32_t height, TextureUsage usage, CompressedTexture& result, uint32_t threadCount = 0, uint32_t maxLevels = 0)
+    {
+        VkFormat format = ChooseFormat(pixels, width, height, usage);
+        if(!IsSupported(format))
+            return false;
+
+        buildLevels(pixels, width, height, format, usage == TextureUsage::Color, result, threadCount, maxLevels);
+        return true;
+    }
+
+    //Та же цепочка без сжатия, RGBA8 - когда BC не поддерживается
+    static void BuildUncompressed(const uint8_t* pixels, uint32_t width, uint32_t height, TextureUsage usage, CompressedTexture& result, uint32_t maxLevels = 0)
+    {
+        bool srgb = usage == TextureUsage::Color;
+        buildLevels(pixels, width, height, srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM, srgb, result, 1, maxLevels);
+    }
+
+    static bool IsBlockCompressed(VkFormat format)
+    {
+        return format != VK_FORMAT_R8G8B8A8_SRGB && format != VK_FORMAT_R8G8B8A8_UNORM;
+    }
+
+    static uint32_t GetBlockSize(VkFormat format)
+    {
+        switch(format)
+        {
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC4_UNORM_BLOCK:
+                return 8;
+            case VK_FORMAT_R8G8B8A8_SRGB:
+            case VK_FORMAT_R8G8B8A8_UNORM:
+                return 4;
+            default:
+                return 16;
+        }
+    }
+
+    static size_t GetLevelSize(VkFormat format, uint32_t width, uint32_t height)
+    {
+        if(!IsBlockCompressed(format))
+            return static_cast<size_t>(width) * height * 4;
+
+        return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * GetBlockSize(format);
+    }
+
+    //Строк блоков на поток меньше этого - сжимаем в одном потоке
+    inline static const uint32_t MinRowsPerThread = 16;
+
+private:
+    static void buildLevels(const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat format, bool srgb, CompressedTexture& result, uint32_t threadCount, uint32_t maxLevels)
+    {
+        uint32_t mipLevels = 1;
+        while((std::max(width, height) >> mipLevels) > 0)
+            mipLevels++;
+
+        if(maxLevels > 0)
+            mipLevels = std::min(mipLevels, maxLevels);
+
+        result.format = format;
+        result.width = width;
+        result.height = height;
+        result.mipLevels = mipLevels;
+        result.offsets.clear();
+
+        size_t total = 0;
+        for(uint32_t i = 0; i < mipLevels; i++)
+        {
+            result.offsets.push_back(total);
+            total += GetLevelSize(format, std::max(width >> i, 1u), std::max(height >> i, 1u));
+        }
+        result.data.resize(total);
+
+        std::vector<uint8_t> level(pixels, pixels + static_cast<size_t>(width) * height * 4);
+        std::vector<uint8_t> next;
+
+        for(uint32_t i = 0; i < mipLevels; i++)
+        {
+            uint32_t levelWidth = std::max(width >> i, 1u);
+            uint32_t levelHeight = std::max(height >> i, 1u);
+
+            if(i > 0)
+            {
+                uint32_t previousWidth = std::max(width >> (i - 1), 1u);
+                uint32_t previousHeight = std::max(height >> (i - 1), 1u);
+
+                next.resize(static_cast<size_t>(levelWidth) * levelHeight * 4);
+                if(srgb)
+                    stbir_resize_uint8_srgb(level.data(), previousWidth, previousHeight, 0, next.data(), levelWidth, levelHeight, 0, 4, 3, 0);
+                else
+                    stbir_resize_uint8(level.data(), previousWidth, previousHeight, 0, next.data(), levelWidth, levelHeight, 0, 4);
+
+                level.swap(next);
+            }
+
+            if(IsBlockCompressed(format))
+                compressLevel(level.data(), levelWidth, levelHeight, format, result.data.data() + result.offsets[i], threadCount);
+            else
+                memcpy(result.data.data() + result.offsets[i], level.data(), level.size());
+        }
+    }
+
+    static void compressLevel(const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat format, uint8_t* output, uint32_t threadCount)
+    {
+        uint32_t blocksX = (width + 3) / 4;
+        uint32_t blocksY = (height + 3) / 4;
+        uint32_t blockSize = GetBlockSize(format);
+
+        if(threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        threadCount = std::max(1u, std::min(threadCount, blocksY / MinRowsPerThread));
+
+        auto encodeRows = [&](uint32_t firstRow, uint32_t lastRow){
+            uint8_t block[64];
+
+            for(uint32_t by = firstRow; by < lastRow; by++)
+                for(uint32_t bx = 0; bx < blocksX; bx++)
+                {
+                    //Края, не кратные 4, дополняются повтором крайних пикселей
+                    for(uint32_t y = 0; y < 4; y++)
+                        for(uint32_t x = 0; x < 4; x++)
+                        {
+                            uint32_t px = std::min(bx * 4 + x, width - 1);
+                            uint32_t py = std::min(by * 4 + y, height - 1);
+                            const uint8_t* src = pixels + (static_cast<size_t>(py) * width + px) * 4;
+                            uint32_t i = y * 4 + x;
+
+                            switch(format)
+                            {
+                                case VK_FORMAT_BC4_UNORM_BLOCK:
+                                    block[i] = src[0];
+                                    break;
+                                case VK_FORMAT_BC5_UNORM_BLOCK:
+                                    block[i * 2] = src[0];
+                                    block[i * 2 + 1] = src[1];
+                                    break;
+                                default:
+                                    memcpy(block + i * 4, src, 4);
+                                    break;
+                            }
+                        }
+
+                    uint8_t* dest = output + (static_cast<size_t>(by) * blocksX + bx) * blockSize;
+
+                    switch(format)
+                    {
+                        case VK_FORMAT_BC4_UNORM_BLOCK:
+                            stb_compress_bc4_block(dest, block);
+                            break;
+                        case VK_FORMAT_BC5_UNORM_BLOCK:
+                            stb_compress_bc5_block(dest, block);
+                            break;
+                        case VK_FORMAT_BC3_SRGB_BLOCK:
+                            stb_compress_dxt_block(dest, block, 1, STB_DXT_HIGHQUAL);
+                            break;
+                        default:
+                            stb_compress_dxt_block(dest, block, 0, STB_DXT_HIGHQUAL);
+                            break;
+                    }
+                }
+        };
+
+        if(threadCount == 1)
+        {
+            encodeRows(0, blocksY);
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount);
+        for(uint32_t t = 0; t < threadCount; t++)
+            threads.emplace_back(encodeRows, blocksY * t / threadCount, blocksY * (t + 1) / threadCount);
+
+        for(auto& thread : threads)
+            thread.join();
+    }
+
+    static const int FormatCount = 4;
+
+    inline static const VkFormat formats[FormatCount] = {
+        VK_FORMAT_BC1_RGB_SRGB_BLOCK,
+        VK_FORMAT_BC3_SRGB_BLOCK,
+        VK_FORMAT_BC4_UNORM_BLOCK,
+        VK_FORMAT_BC5_UNORM_BLOCK
+    };
+
+    inline static bool supported[FormatCount] = {};
+};
@@ -0,0 +1,328 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "assetLoader.h"
+#include "deletionQueue.h"
+#include "texture.h"
+
+#include <unordered_map>
+
+//Текстура, у которой в GPU лежит только хвост мип-цепочки начиная с residentLevel.
+//Все уровни остаются на CPU (обычно это отображённый .tex), так что переход на другой
+//уровень - это только загрузка в GPU без чтения и декодирования файла
+class StreamedTexture{
+public:
+    StreamedTexture(Device* device)
+    {
+        this->device = device;
+    }
+
+    bool IsLoaded() const { return source.IsValid(); }
+
+    uint32_t GetWidth() const { return source.width; }
+    uint32_t GetHeight() const { return source.height; }
+    uint32_t GetMipLevels() const { return source.mipLevels; }
+
+    //Уровень, с которого начинается цепочка в GPU; GetMipLevels() - ещё ничего не загружено
+    uint32_t GetResidentLevel() const { return residentLevel; }
+
+    //Самый грубый допустимый уровень: мелкие уровни до MinResidentSize держатся всегда
+    uint32_t GetBaseLevel() const
+    {
+        uint32_t level = 0;
+        while(level + 1 < source.mipLevels && std::max(source.width >> level, source.height >> level) > MinResidentSize)
+            level++;
+
+        return level;
+    }
+
+    //Вызывается отсечением для каждого видимого пользователя; за кадр берётся самый детальный уровень
+    void Request(uint32_t level)
+    {
+        requestedLevel = std::min(requestedLevel, level);
+        requested = true;
+    }
+
+    std::shared_ptr<Texture> GetTexture() const { return texture; }
+
+    //owner - ключ для Unsubscribe; onChanged зовётся в главном потоке при каждой подмене Texture
+    void Subscribe(void* owner, std::function<void(std::shared_ptr<Texture>)> onChanged)
+    {
+        listeners.push_back({owner, onChanged});
+    }
+
+    void Unsubscribe(void* owner)
+    {
+        listeners.erase(std::remove_if(listeners.begin(), listeners.end(), [owner](auto& listener){ return listener.first == owner; }), listeners.end());
+    }
+
+    //Байты уровней [level, mipLevels) в GPU
+    VkDeviceSize GetLevelBytes(uint32_t level) const
+    {
+        VkDeviceSize bytes = 0;
+        for(uint32_t i = level; i < source.mipLevels; i++)
+            bytes += TextureCompressor::GetLevelSize(source.format, std::max(source.width >> i, 1u), std::max(source.height >> i, 1u));
+
+        return bytes;
+    }
+
+    inline static const uint32_t MinResidentSize = 64;
+
+private:
+    friend class TextureStreamer;
+
+    //Копирование уровней записывается в буфер команд кадра через TextureStreamer::Record
+    void setLevel(uint32_t level, std::vector<std::shared_ptr<Texture>>& uploads)
+    {
+        std::shared_ptr<Texture> next = DeletionQueue::MakeShared(new Texture(device));
+        next->CreateDeferred(source, level);
+        uploads.push_back(next);
+
+        texture = next;
+        residentLevel = level;
+
+        for(auto& listener : listeners)
+            listener.second(texture);
+    }
+
+    Device* device;
+
+    std::string path;
+    CompressedTexture source;
+    std::shared_ptr<Texture> texture;
+
+    uint32_t residentLevel = 0;
+    uint32_t requestedLevel = UINT32_MAX;
+    bool requested = false;
+    uint64_t lastUsed = 0;
+
+    AssetHandle request;
+    std::vector<std::pair<void*, std::function<void(std::shared_ptr<Texture>)>>> listeners;
+};
+
+//Держит детальные мип-уровни только у тех текстур, которые сейчас крупно видны на экране.
+//Сначала грузится хвост цепочки до MinResidentSize, затем по запросам отсечения - более
+//детальные уровни, пока суммарный объём укладывается в budget; при нехватке места
+//у давно не видимых текстур детальные уровни выгружаются (LRU). Каждая смена уровня - это
+//новая картинка, так что и выгрузка считается в MaxUploadsPerFrame. Сами копирования не
+//отправляются в очередь отдельно, а пишутся в буфер команд кадра (Record)
+class TextureStreamer{
+public:
+    TextureStreamer(Device* device)
+    {
+        this->device = device;
+    }
+
+    //Одна запись на путь; картинка разбирается на пуле потоков AssetLoader
+    std::shared_ptr<StreamedTexture> Load(AssetLoader& loader, const std::string& path, JobPriority priority = JobPriority::Normal)
+    {
+        auto it = textures.find(path);
+        if(it != textures.end())
+            if(auto texture = it->second.lock())
+                return texture;
+
+        auto texture = std::make_shared<StreamedTexture>(device);
+        texture->path = path;
+
+        std::weak_ptr<StreamedTexture> weak = texture;
+        texture->request = loader.LoadTexture(path, priority, [this, weak](TextureData& data){
+            auto texture = weak.lock();
+            if(!texture)
+                return;
+
+            texture->source = std::move(data.compressed);
+            texture->setLevel(texture->GetBaseLevel(), uploads);
+        });
+
+        textures[path] = texture;
+        return texture;
+    }
+
+    //Файл изменился на диске: цепочка перечитывается в фоне, затем в GPU заново грузится
+    //тот же по детальности уровень. false - такой текстуры нет
+    bool Reload(AssetLoader& loader, const std::string& path, std::function<void()> onReloaded, std::function<void()> onFailed = nullptr)
+    {
+        auto it = textures.find(path);
+        std::shared_ptr<StreamedTexture> texture = it != textures.end() ? it->second.lock() : nullptr;
+        if(!texture)
+            return false;
+
+        std::weak_ptr<StreamedTexture> weak = texture;
+        texture->request = loader.LoadTexture(path, JobPriority::High, [this, weak, onReloaded](TextureData& data){
+            auto texture = weak.lock();
+            if(!texture)
+                return;
+
+            texture->source = std::move(data.compressed);
+            //Размер картинки мог измениться, поэтому не грубее нового базового уровня
+            texture->setLevel(std::min(texture->residentLevel, texture->GetBaseLevel()), uploads);
+
+            onReloaded();
+        }, onFailed);
+
+        return true;
+    }
+
+    //Главный поток, раз в кадр после отсечения
+    void Update()
+    {
+        frame++;
+
+        std::vector<StreamedTexture*> live;
+        residentBytes = 0;
+
+        for(auto it = textures.begin(); it != textures.end();)
+        {
+            auto texture = it->second.lock();
+            if(!texture)
+            {
+                it = textures.erase(it);
+                continue;
+            }
+
+            if(texture->IsLoaded())
+            {
+                residentBytes += texture->GetLevelBytes(texture->residentLevel);
+                live.push_back(texture.get());
+            }
+
+            ++it;
+        }
+
+        //Цель на этот кадр: запрошенный уровень, а у давно не видимых - базовый
+        std::vector<std::pair<StreamedTexture*, uint32_t>> upgrades;
+        std::vector<StreamedTexture*> stale;
+
+        for(auto texture : live)
+        {
+            uint32_t base = texture->GetBaseLevel();
+            uint32_t target = texture->residentLevel;
+
+            if(texture->requested)
+            {
+                texture->lastUsed = frame;
+                target = std::min(texture->requestedLevel, base);
+            }
+            else if(frame - texture->lastUsed > UnusedFrames)
+                target = base;
+
+            texture->requested = false;
+            texture->requestedLevel = UINT32_MAX;
+
+            if(target < texture->residentLevel)
+                upgrades.push_back({texture, target});
+            else if(target > texture->residentLevel && target == base)
+                stale.push_back(texture);
+        }
+
+        //Сначала те, кому не хватает больше всего уровней
+        std::sort(upgrades.begin(), upgrades.end(), [](auto& a, auto& b){
+            return a.first->residentLevel - a.second > b.first->residentLevel - b.second;
+        });
+
+        uint32_t changes = 0;
+        for(auto& [texture, target] : upgrades)
+        {
+            if(changes >= MaxUploadsPerFrame)
+                break;
+
+            //Освобождаем место за счёт давно не видимых, пока не влезет, выгружать больше нечего
+            //или в этом кадре остаётся место только под саму загрузку
+            while(residentBytes - texture->GetLevelBytes(texture->residentLevel) + texture->GetLevelBytes(target) > budget &&
+                  changes + 1 < MaxUploadsPerFrame)
+            {
+                if(!evictLeastRecent(live, texture))
+                    break;
+                changes++;
+            }
+
+            //Не влезло - берём самый детальный уровень, который ещё помещается
+            while(target < texture->residentLevel &&
+                  residentBytes - texture->GetLevelBytes(texture->residentLevel) + texture->GetLevelBytes(target) > budget)
+                target++;
+
+            if(target >= texture->residentLevel)
+                continue;
+
+            residentBytes -= texture->GetLevelBytes(texture->residentLevel);
+            texture->setLevel(target, uploads);
+            residentBytes += texture->GetLevelBytes(target);
+            changes++;
+        }
+
+        //Остальные невидимые выгружаются в следующих кадрах, начиная с самых старых
+        std::sort(stale.begin(), stale.end(), [](auto a, auto b){ return a->lastUsed < b->lastUsed; });
+
+        for(auto texture : stale)
+        {
+            if(changes >= MaxUploadsPerFrame)
+                break;
+
+            if(texture->residentLevel >= texture->GetBaseLevel())
+                continue;
+
+            evict(texture);
+            changes++;
+        }
+    }
+
+    //До начала render pass, в тот же кадр, что и Update: новые картинки читаются уже этим кадром
+    void Record(VkCommandBuffer commandBuffer)
+    {
+        for(auto& texture : uploads)
+            texture->RecordUpload(commandBuffer);
+
+        uploads.clear();
+    }
+
+    VkDeviceSize GetResidentBytes() const { return residentBytes; }
+    size_t GetTextureCount() const { return textures.size(); }
+
+    //Лимит видеопамяти под стримящиеся текстуры
+    VkDeviceSize budget = 256ull * 1024 * 1024;
+
+    //Смен уровня за кадр, и загрузок, и выгрузок
+    inline static const uint32_t MaxUploadsPerFrame = 2;
+    //Через столько кадров без запросов детальные уровни выгружаются
+    inline static const uint64_t UnusedFrames = 300;
+
+private:
+    void evict(StreamedTexture* texture)
+    {
+        residentBytes -= texture->GetLevelBytes(texture->residentLevel);
+        texture->setLevel(texture->GetBaseLevel(), uploads);
+        residentBytes += texture->GetLevelBytes(texture->residentLevel);
+    }
+
+    //Текстура с самым старым lastUsed, у которой есть что выгрузить
+    bool evictLeastRecent(const std::vector<StreamedTexture*>& live, StreamedTexture* keep)
+    {
+        StreamedTexture* victim = nullptr;
+
+        for(auto texture : live)
+        {
+            if(texture == keep || texture->residentLevel >= texture->GetBaseLevel() || texture->lastUsed == frame)
+                continue;
+
+            if(!victim || texture->lastUsed < victim->lastUsed)
+                victim = texture;
+        }
+
+        if(!victim)
+            return false;
+
+        evict(victim);
+        return true;
+    }
+
+    std::unordered_map<std::string, std::weak_ptr<StreamedTexture>> textures;
+
+    //Созданные в этом кадре картинки, копирование в которые ещё не записано
+    std::vector<std::shared_ptr<Texture>> uploads;
+
+    VkDeviceSize residentBytes = 0;
+    uint64_t frame = 0;
+
+    Device* device;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+
+enum class JobPriority{
+    High,
+    Normal,
+    Low
+};
+
+//Пул рабочих потоков с очередью на каждый приоритет: поток берёт задачу из самой приоритетной непустой очереди
+class ThreadPool{
+public:
+    ThreadPool(uint32_t threadCount = 0)
+    {
+        if(threadCount == 0)
+            threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+        for(uint32_t i = 0; i < threadCount; i++)
+            workers.emplace_back([this]{ run(); });
+    }
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        for(auto& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Submit(std::function<void()> job, JobPriority priority = JobPriority::Normal)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queues[static_cast<int>(priority)].push_back(std::move(job));
+        }
+
+        wake.notify_one();
+    }
+
+    //Ждёт, пока очереди опустеют и все начатые задачи закончатся
+    void WaitIdle()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]{ return active == 0 && empty(); });
+    }
+
+    uint32_t GetThreadCount() const
+    {
+        return static_cast<uint32_t>(workers.size());
+    }
+
+private:
+    bool empty() const
+    {
+        for(auto& queue : queues)
+            if(!queue.empty())
+                return false;
+
+        return true;
+    }
+
+    void run()
+    {
+        while(true)
+        {
+            std::function<void()> job;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]{ return stopping || !empty(); });
+
+                //Оставшиеся в очереди задачи при остановке выбрасываются
+                if(stopping)
+                    return;
+
+                for(auto& queue : queues)
+                {
+                    if(queue.empty())
+                        continue;
+
+                    job = std::move(queue.front());
+                    queue.pop_front();
+                    break;
+                }
+
+                active++;
+            }
+
+            job();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                active--;
+            }
+
+            idle.notify_all();
+        }
+    }
+
+    std::vector<std::thread> workers;
+
+    std::deque<std::function<void()>> queues[3];
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+
+    uint32_t active = 0;
+    bool stopping = false;
+};
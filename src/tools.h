@@ -7,7 +7,17 @@
 
 struct PrimitiveObject{
     std::vector<Vertex> vertices;
-    std::vector<uint16_t> indices;
+    std::vector<uint32_t> indices;
+};
+
+//Рабочая память MakeMCubes: у каждого потока своя, буферы переиспользуются между чанками
+struct MCubesScratch{
+    //Плотность (size + 3)^3 с полем в одну ячейку со всех сторон - для градиента на границе
+    std::vector<float> density;
+    std::vector<float> heights;
+    //Вершина на рёбрах +x, +y, +z каждого узла, UINT32_MAX - ещё нет
+    std::vector<uint32_t> edgeVertices;
+    BasicPerlinNoise noise;
 };
 
 enum PrimitiveType{
@@ -30,7 +40,7 @@ public:
 
     }
 
-    static VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) {
+    static VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1) {
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         viewInfo.image = image;
@@ -38,7 +48,7 @@ public:
         viewInfo.format = format;
         viewInfo.subresourceRange.aspectMask = aspectFlags;
         viewInfo.subresourceRange.baseMipLevel = 0;
-        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.levelCount = mipLevels;
         viewInfo.subresourceRange.baseArrayLayer = 0;
         viewInfo.subresourceRange.layerCount = 1;
         
@@ -51,14 +61,14 @@ public:
         return imageView;
     }
 
-    static void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+    static void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, uint32_t mipLevels = 1) {
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
         imageInfo.extent.width = width;
         imageInfo.extent.height = height;
         imageInfo.extent.depth = 1;
-        imageInfo.mipLevels = 1;
+        imageInfo.mipLevels = mipLevels;
         imageInfo.arrayLayers = 1;
         imageInfo.format = format;
         imageInfo.tiling = tiling;
@@ -207,11 +217,21 @@ public:
         return PrimitiveObject({{},{}});
     }
 
+    //Можно звать из нескольких потоков одновременно, если у каждого свой scratch
+    static PrimitiveObject GetMCubes(glm::vec3 pos, MCubesScratch& scratch)
+    {
+        return MakeMCubes(ChunkSize, pos, scratch);
+    }
+
     static PrimitiveObject GetMCubes(glm::vec3 pos)
     {
-                return MakeMCubes(16, pos);
+        MCubesScratch scratch;
+        return MakeMCubes(ChunkSize, pos, scratch);
     }
 
+    //Сторона чанка в ячейках; MakeMCubes сдвигает выборку шума на pos * 16
+    inline static const int ChunkSize = 16;
+
     inline static Device* device;
 
 private:
@@ -563,250 +583,116 @@ private:
         return pObject;
     }
 
-    static PrimitiveObject MakeMCubes(size_t size, glm::vec3 pos){
+    //Плотность - высота рельефа минус высота точки, поверхность на нуле. Вершины лежат на рёбрах
+    //сетки и общие у соседних ячеек (кэш по узлу и оси ребра), нормаль - по градиенту плотности
+    static PrimitiveObject MakeMCubes(size_t size, glm::vec3 pos, MCubesScratch& scratch){
 
         PrimitiveObject pObject;
 
-        BasicPerlinNoise noise;
-
-        Gdata.clear();
-        
-		double fx = size / 8.0f;
-		double fy = size / 8.0f;
+        int n = static_cast<int>(size);
+        int padded = n + 3;
 
-        srand(234525);
-
-        Gdata.resize(size + 1);
-        for (int x = 0; x < size + 1; x++)
-        {
-            Gdata[x].resize(size + 1);
-            for (int y = 0; y < size + 1; y++)
+        //Рельеф зависит только от x и z: шум один раз на столбец
+        scratch.heights.resize(padded * padded);
+        for (int x = 0; x < padded; x++)
+            for (int z = 0; z < padded; z++)
             {
-                Gdata[x][y].resize(size + 1);
-                for (int z = 0; z < size + 1; z++)
-                {
-                    float val = 0;
-                    float posx = (pos.x * 16)  + x;
-                    float posz = (pos.z * 16)  + z;
-                    //if(y > size / 2)
-                    {
-                        //val = std::sin((posx) / 50 + (posz) / 50) * 10;
-                        val = noise.accumulatedOctaveNoise2D(posx / 100, posz / 100, 8.0f) * 10 + 20;
-                        if(val > (pos.y * 16) + y)
-                            Gdata[x][y][z] = val;
-                        else
-                            Gdata[x][y][z] = 0;
-                    }
-                    // else if( y <= size / 2)
-                    // {
-                    //     val = noise.noise(x, y, z);
-                    //     Gdata[x][y][z] = (1 + val) - y ;
-                    // }
-                }
+                float posx = (pos.x * ChunkSize) + x - 1;
+                float posz = (pos.z * ChunkSize) + z - 1;
+                scratch.heights[x * padded + z] = scratch.noise.accumulatedOctaveNoise2D(posx / 100, posz / 100, 8.0f) * 10 + 20;
             }
-        }
 
-        for (int i = 0; i < size; i++)
-        {
-            for (int j = 0; j < size; j++)
+        std::vector<float>& density = scratch.density;
+        density.resize(padded * padded * padded);
+        for (int x = 0; x < padded; x++)
+            for (int y = 0; y < padded; y++)
             {
-                for (int k = 0; k < size; k++)
-                {
-                    //Заполняем _triangles и получаем количество треугольников
-                    Polygonise(i, j, k, 5, &pObject);
-                }
+                float posy = (pos.y * ChunkSize) + y - 1;
+                float* row = &density[(x * padded + y) * padded];
+                const float* heights = &scratch.heights[x * padded];
+
+                for (int z = 0; z < padded; z++)
+                    row[z] = heights[z] - posy;
             }
-        }
 
-        return pObject;
-    }
+        int nodes = n + 1;
+        scratch.edgeVertices.assign(nodes * nodes * nodes * 3, UINT32_MAX);
 
-    //для удобства и избежания лишних расчетов и выделения памяти;)
-    static double GetVal(int x, int y, int z, int i)
-    {
-        switch (i)
-        {
-            case 0:
-                return Gdata[x][y][z];
-            case 1:
-                return Gdata[x + 1][y][z];
-            case 2:
-                return Gdata[x + 1][y + 1][z];
-            case 3:
-                return Gdata[x][y + 1][z];
-            case 4:
-                return Gdata[x][y][z + 1];
-            case 5:
-                return Gdata[x + 1][y][z + 1];
-            case 6:
-                return Gdata[x + 1][y + 1][z + 1];
-            case 7:
-                return Gdata[x][y + 1][z + 1];
-            }
-        return 0;
-    }
+        //Узел (x, y, z) без поля
+        auto sample = [&](int x, int y, int z){
+            return density[((x + 1) * padded + (y + 1)) * padded + (z + 1)];
+        };
 
-    static glm::vec3 GetPos(int x, int y, int z, int i)
-    {
-        glm::vec3 nVec;
-         switch (i)
-        {
-            case 0:
-                nVec.x = x;
-                nVec.y = y;
-                nVec.z = z;
-                return nVec;
-            case 1:
-                nVec.x = x + 1;
-                nVec.y = y;
-                nVec.z = z;
-                return nVec;
-            case 2:
-                nVec.x = x + 1;
-                nVec.y = y + 1;
-                nVec.z = z;
-                return nVec;
-            case 3:
-                nVec.x = x;
-                nVec.y = y + 1;
-                nVec.z = z;
-                return nVec;
-            case 4:
-                nVec.x = x;
-                nVec.y = y;
-                nVec.z = z + 1;
-                return nVec;
-            case 5:
-                nVec.x = x + 1;
-                nVec.y = y;
-                nVec.z = z + 1;
-                return nVec;
-            case 6:
-                nVec.x = x + 1;
-                nVec.y = y + 1;
-                nVec.z = z + 1;
-                return nVec;
-            case 7:
-                nVec.x = x;
-                nVec.y = y + 1;
-                nVec.z = z + 1;
-                return nVec;
-            }
-        return nVec;
-    }
+        auto gradient = [&](int x, int y, int z){
+            return glm::vec3(sample(x + 1, y, z) - sample(x - 1, y, z),
+                             sample(x, y + 1, z) - sample(x, y - 1, z),
+                             sample(x, y, z + 1) - sample(x, y, z - 1));
+        };
 
-    static void Polygonise(int x, int y, int z, double isolevel, PrimitiveObject* pObject)
-    {
-        glm::vec3* vertlist = new glm::vec3[12];
-        int i, ntriang = 0;
-        int cubeindex = 0;
-
-        //Определяем какой куб перед нами(фактически индекс в таблице)
-        if (GetVal(x, y, z, 0) > isolevel) cubeindex |= 1;
-        if (GetVal(x, y, z, 1) > isolevel) cubeindex |= 2;
-        if (GetVal(x, y, z, 2) > isolevel) cubeindex |= 4;
-        if (GetVal(x, y, z, 3) > isolevel) cubeindex |= 8;
-        if (GetVal(x, y, z, 4) > isolevel) cubeindex |= 16;
-        if (GetVal(x, y, z, 5) > isolevel) cubeindex |= 32;
-        if (GetVal(x, y, z, 6) > isolevel) cubeindex |= 64;
-        if (GetVal(x, y, z, 7) > isolevel) cubeindex |= 128;
- 
-        /* Cube is entirely in/out of the surface */
-        if (_edgeTable[cubeindex] == 0)
-            return;
-             
-        //Ищем конкретные положения вершин, используя линейную интерполяцию
-        /* Find the vertices where the surface intersects the cube */
-        if ((_edgeTable[cubeindex] & 1) > 0)
-                vertlist[0] = 
-                    VertexInterp(isolevel, GetPos(x,y,z,0), GetPos(x,y,z,1), GetVal(x, y, z, 0), GetVal(x, y, z, 1));
-        if ((_edgeTable[cubeindex] & 2) > 0)
-                vertlist[1] =
-                   VertexInterp(isolevel, GetPos(x,y,z,1), GetPos(x,y,z,2), GetVal(x, y, z, 1), GetVal(x, y, z, 2));
-        if ((_edgeTable[cubeindex] & 4) > 0)
-                vertlist[2] =
-                   VertexInterp(isolevel, GetPos(x,y,z,2), GetPos(x,y,z,3), GetVal(x, y, z, 2), GetVal(x, y, z, 3));
-        if ((_edgeTable[cubeindex] & 8) > 0)
-                vertlist[3] =
-                   VertexInterp(isolevel, GetPos(x,y,z,3), GetPos(x,y,z,0), GetVal(x, y, z, 3), GetVal(x, y, z, 0));
-        if ((_edgeTable[cubeindex] & 16) > 0)
-                vertlist[4] =
-                   VertexInterp(isolevel, GetPos(x,y,z,4), GetPos(x,y,z,5), GetVal(x, y, z, 4), GetVal(x, y, z, 5));
-        if ((_edgeTable[cubeindex] & 32) > 0)
-                vertlist[5] =
-                   VertexInterp(isolevel, GetPos(x,y,z,5), GetPos(x,y,z,6), GetVal(x, y, z, 5), GetVal(x, y, z, 6));
-        if ((_edgeTable[cubeindex] & 64) > 0)
-                vertlist[6] =
-                   VertexInterp(isolevel, GetPos(x,y,z,6), GetPos(x,y,z,7), GetVal(x, y, z, 6), GetVal(x, y, z, 7));
-        if ((_edgeTable[cubeindex] & 128) > 0)
-                vertlist[7] =
-                   VertexInterp(isolevel, GetPos(x,y,z,7), GetPos(x,y,z,4), GetVal(x, y, z, 7), GetVal(x, y, z, 4));
-        if ((_edgeTable[cubeindex] & 256) > 0)
-                vertlist[8] =
-                   VertexInterp(isolevel, GetPos(x,y,z,0), GetPos(x,y,z,4), GetVal(x, y, z, 0), GetVal(x, y, z, 4));
-        if ((_edgeTable[cubeindex] & 512) > 0)
-                vertlist[9] =
-                   VertexInterp(isolevel, GetPos(x,y,z,1), GetPos(x,y,z,5), GetVal(x, y, z, 1), GetVal(x, y, z, 5));
-        if ((_edgeTable[cubeindex] & 1024) > 0)
-                vertlist[10] =
-                   VertexInterp(isolevel, GetPos(x,y,z,2), GetPos(x,y,z,6), GetVal(x, y, z, 2), GetVal(x, y, z, 6));
-        if ((_edgeTable[cubeindex] & 2048) > 0)
-            vertlist[11] =
-                    VertexInterp(isolevel, GetPos(x,y,z,3), GetPos(x,y,z,7), GetVal(x, y, z, 3), GetVal(x, y, z, 7));
-       
-        //Ну и создаем треугольник, индексы вершин берем из _triTable, а вершины определяем по cubeindex  
-        /* Create the triangle */
-        for (i = 0; _triTable[cubeindex][i] != -1; i += 3)
-        {
-            float r = 0.2f;
-            float g = 0.6f;
-            float b = 0.2f;
+        auto edgeVertex = [&](int x, int y, int z, int axis){
+            uint32_t& cached = scratch.edgeVertices[((x * nodes + y) * nodes + z) * 3 + axis];
+            if(cached != UINT32_MAX)
+                return cached;
 
-            glm::vec3 normal =  glm::cross(vertlist[_triTable[cubeindex][i + 1]] - vertlist[_triTable[cubeindex][i]], vertlist[_triTable[cubeindex][i + 2]] - vertlist[_triTable[cubeindex][i]]);
- 
+            glm::ivec3 a(x, y, z);
+            glm::ivec3 b = a;
+            b[axis]++;
 
-            pObject->vertices.push_back({{vertlist[_triTable[cubeindex][i]].x, vertlist[_triTable[cubeindex][i]].y, vertlist[_triTable[cubeindex][i]].z}, normal, {r,g,b}});
-            pObject->vertices.push_back({{vertlist[_triTable[cubeindex][i + 1]].x, vertlist[_triTable[cubeindex][i + 1]].y, vertlist[_triTable[cubeindex][i + 1]].z}, normal, {r,g,b}});
-            pObject->vertices.push_back({{vertlist[_triTable[cubeindex][i + 2]].x, vertlist[_triTable[cubeindex][i + 2]].y, vertlist[_triTable[cubeindex][i + 2]].z}, normal, {r,g,b}});
+            float da = sample(a.x, a.y, a.z);
+            float db = sample(b.x, b.y, b.z);
+            float t = std::abs(db - da) > 0.00001f ? std::clamp(-da / (db - da), 0.0f, 1.0f) : 0.5f;
 
-            ntriang++;
-        }
+            glm::vec3 position = glm::mix(glm::vec3(a), glm::vec3(b), t);
+            //Плотность растёт вглубь, наружу смотрит минус градиент
+            glm::vec3 normal = -glm::mix(gradient(a.x, a.y, a.z), gradient(b.x, b.y, b.z), t);
+            float length = glm::length(normal);
 
-        if(ntriang > 0)
-        {
-            int size = pObject->vertices.size() - 1;
+            cached = static_cast<uint32_t>(pObject.vertices.size());
+            pObject.vertices.push_back({position, length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f), {0.2f, 0.6f, 0.2f}});
+            return cached;
+        };
 
-            for(int i=0; i < ntriang; i ++)
-            {
-                int step = i * 3;
-                pObject->indices.push_back(size - step - 2);
-                pObject->indices.push_back(size - step - 1);
-                pObject->indices.push_back(size - step);
-            }
-        }
-    }
+        for (int x = 0; x < n; x++)
+            for (int y = 0; y < n; y++)
+                for (int z = 0; z < n; z++)
+                {
+                    int cubeindex = 0;
+                    for (int i = 0; i < 8; i++)
+                        if (sample(x + CornerOffsets[i][0], y + CornerOffsets[i][1], z + CornerOffsets[i][2]) > 0.0f)
+                            cubeindex |= 1 << i;
 
-    //Просто линейная интерполяция, наверное не очень быстрая, но узкое место не здесь
-    static glm::vec3 VertexInterp(double isolevel, glm::vec3 p1, glm::vec3 p2, double valp1, double valp2)
-    {
-        double mu;
-        glm::vec3 p;
- 
-        if (std::abs(isolevel - valp1) < 0.00001)
-            return p1;
-        if (std::abs(isolevel - valp2) < 0.00001)
-            return p2;
-        if (std::abs(valp1 - valp2) < 0.00001)
-            return p1;
-
-        mu = (isolevel - valp1) / (valp2 - valp1);
-        p.x = (float)(p1.x + mu * (p2.x - p1.x));
-        p.y = (float)(p1.y + mu * (p2.y - p1.y));
-        p.z = (float)(p1.z + mu * (p2.z - p1.z));
- 
-        return p;
+                    //Ячейка целиком внутри или снаружи
+                    if (_edgeTable[cubeindex] == 0)
+                        continue;
+
+                    uint32_t edges[12];
+                    for (int e = 0; e < 12; e++)
+                        if (_edgeTable[cubeindex] & (1 << e))
+                            edges[e] = edgeVertex(x + EdgeOrigins[e][0], y + EdgeOrigins[e][1], z + EdgeOrigins[e][2], EdgeAxes[e]);
+
+                    for (int i = 0; _triTable[cubeindex][i] != -1; i += 3)
+                    {
+                        pObject.indices.push_back(edges[_triTable[cubeindex][i]]);
+                        pObject.indices.push_back(edges[_triTable[cubeindex][i + 1]]);
+                        pObject.indices.push_back(edges[_triTable[cubeindex][i + 2]]);
+                    }
+                }
+
+        return pObject;
     }
 
+    //Углы ячейки и рёбра в нумерации таблиц: ребро задаётся узлом-началом и осью
+    inline static const int CornerOffsets[8][3] = {
+        {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+        {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}
+    };
+    inline static const int EdgeOrigins[12][3] = {
+        {0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 0},
+        {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {0, 0, 1},
+        {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}
+    };
+    inline static const int EdgeAxes[12] = {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2};
+
     inline static PrimitiveObject quad =  {
         {
             {{-0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
@@ -1156,5 +1042,4 @@ private:
         {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}
         }; 
 
-    inline static std::vector<std::vector<std::vector<int>>> Gdata;
 };
\ No newline at end of file
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "stdinclude.h"
+
+//Иерархия трансформаций: локальные данные и мировые матрицы лежат в плотных массивах,
+//пересчитываются только "грязные" узлы и их потомки
+class Transforms{
+public:
+    inline static const uint32_t NoParent = UINT32_MAX;
+
+    static uint32_t Create(uint32_t parent = NoParent)
+    {
+        uint32_t id;
+
+        if(!freeIds.empty())
+        {
+            id = freeIds.back();
+            freeIds.pop_back();
+        }
+        else
+        {
+            id = static_cast<uint32_t>(positions.size());
+            positions.emplace_back();
+            rotations.emplace_back();
+            scales.emplace_back();
+            parents.emplace_back();
+            alive.emplace_back();
+            dirty.emplace_back();
+            updated.emplace_back();
+            world.emplace_back();
+            versions.emplace_back(0);
+        }
+
+        positions[id] = glm::vec3(0.0f);
+        rotations[id] = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        scales[id] = glm::vec3(1.0f);
+        parents[id] = parent;
+        alive[id] = true;
+        dirty[id] = true;
+        updated[id] = false;
+        world[id] = glm::mat4(1.0f);
+        versions[id]++;
+
+        anyDirty = true;
+        orderChanged = true;
+
+        return id;
+    }
+
+    static void Destroy(uint32_t id)
+    {
+        for(uint32_t i = 0; i < parents.size(); i++)
+        {
+            if(alive[i] && parents[i] == id)
+                SetParent(i, NoParent);
+        }
+
+        alive[id] = false;
+        freeIds.push_back(id);
+        orderChanged = true;
+    }
+
+    static void SetParent(uint32_t id, uint32_t parent)
+    {
+        parents[id] = parent;
+        markDirty(id);
+        orderChanged = true;
+    }
+
+    static void SetPosition(uint32_t id, glm::vec3 position)
+    {
+        if(positions[id] == position)
+            return;
+
+        positions[id] = position;
+        markDirty(id);
+    }
+
+    static void SetRotation(uint32_t id, glm::quat rotation)
+    {
+        if(rotations[id] == rotation)
+            return;
+
+        rotations[id] = rotation;
+        markDirty(id);
+    }
+
+    static void SetScale(uint32_t id, glm::vec3 scale)
+    {
+        if(scales[id] == scale)
+            return;
+
+        scales[id] = scale;
+        markDirty(id);
+    }
+
+    static glm::vec3 GetPosition(uint32_t id) { return positions[id]; }
+    static glm::quat GetRotation(uint32_t id) { return rotations[id]; }
+    static glm::vec3 GetScale(uint32_t id) { return scales[id]; }
+
+    static const glm::mat4& GetWorld(uint32_t id)
+    {
+        return world[id];
+    }
+
+    //Растёт при каждом пересчёте мировой матрицы и при повторной выдаче id
+    static uint32_t GetVersion(uint32_t id)
+    {
+        return versions[id];
+    }
+
+    //Все мировые матрицы подряд, индекс = id трансформации
+    static const glm::mat4* GetWorldData()
+    {
+        return world.data();
+    }
+
+    static size_t GetCount()
+    {
+        return world.size();
+    }
+
+    static void Update()
+    {
+        if(!anyDirty)
+            return;
+
+        if(orderChanged)
+            rebuildOrder();
+
+        std::vector<uint32_t> touched;
+
+        for(uint32_t id : order)
+        {
+            uint32_t parent = parents[id];
+            bool parentUpdated = parent != NoParent && updated[parent];
+
+            if(!dirty[id] && !parentUpdated)
+                continue;
+
+            glm::mat4 local = glm::translate(glm::mat4(1.0f), positions[id]) * glm::mat4_cast(rotations[id]) * glm::scale(glm::mat4(1.0f), scales[id]);
+
+            world[id] = parent != NoParent ? world[parent] * local : local;
+
+            dirty[id] = false;
+            updated[id] = true;
+            versions[id]++;
+            touched.push_back(id);
+        }
+
+        for(uint32_t id : touched)
+            updated[id] = false;
+
+        anyDirty = false;
+    }
+
+private:
+    static void markDirty(uint32_t id)
+    {
+        dirty[id] = true;
+        anyDirty = true;
+    }
+
+    //Родители обязаны идти раньше детей
+    static void rebuildOrder()
+    {
+        std::vector<uint32_t> depth(parents.size(), 0);
+
+        order.clear();
+        for(uint32_t id = 0; id < parents.size(); id++)
+        {
+            if(!alive[id])
+                continue;
+
+            for(uint32_t p = parents[id]; p != NoParent; p = parents[p])
+                depth[id]++;
+
+            order.push_back(id);
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&depth](uint32_t a, uint32_t b){
+            return depth[a] < depth[b];
+        });
+
+        orderChanged = false;
+    }
+
+    inline static std::vector<glm::vec3> positions;
+    inline static std::vector<glm::quat> rotations;
+    inline static std::vector<glm::vec3> scales;
+    inline static std::vector<uint32_t> parents;
+    inline static std::vector<uint8_t> alive;
+    inline static std::vector<uint8_t> dirty;
+    inline static std::vector<uint8_t> updated;
+    inline static std::vector<glm::mat4> world;
+    inline static std::vector<uint32_t> versions;
+
+    inline static std::vector<uint32_t> order;
+    inline static std::vector<uint32_t> freeIds;
+
+    inline static bool anyDirty = false;
+    inline static bool orderChanged = false;
+};
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include <glm/gtc/packing.hpp>
+
+enum class PositionFormat{
+    Float3,     // 12 байт
+    Unorm16,    // 8 байт, доля от AABB меша
+    Half        // 8 байт, смещение от центра AABB
+};
+
+enum class NormalFormat{
+    Float3,     // 12 байт
+    Oct16       // 4 байта, октаэдрическая развёртка, нужен decodeNormal в шейдере
+};
+
+enum class ColorFormat{
+    Float3,     // 12 байт
+    Rgba8       // 4 байта
+};
+
+enum class TexCoordFormat{
+    Float2,     // 8 байт
+    Half2       // 4 байта
+};
+
+//Описание того, как Vertex лежит в буфере вершин. Из него же строятся описания
+//binding/attribute для пайплайна, так что буфер и пайплайн не разойдутся.
+//При splitPositions позиции идут отдельным потоком (binding 0), остальное - в binding 1,
+//и проходам только по глубине не нужно тянуть атрибуты
+struct VertexLayout{
+    PositionFormat position = PositionFormat::Float3;
+    NormalFormat normal = NormalFormat::Float3;
+    ColorFormat color = ColorFormat::Float3;
+    TexCoordFormat texCoord = TexCoordFormat::Float2;
+    bool splitPositions = false;
+
+    //Раскладка 1 в 1 со struct Vertex
+    static VertexLayout Full()
+    {
+        return VertexLayout{};
+    }
+
+    //20 байт вместо 44, рисуется с shaders/compactVert.spv
+    static VertexLayout Compact()
+    {
+        return {PositionFormat::Unorm16, NormalFormat::Oct16, ColorFormat::Rgba8, TexCoordFormat::Half2};
+    }
+
+    VertexLayout Split() const
+    {
+        VertexLayout layout = *this;
+        layout.splitPositions = true;
+        return layout;
+    }
+
+    bool operator==(const VertexLayout& other) const
+    {
+        return position == other.position && normal == other.normal && color == other.color && texCoord == other.texCoord && splitPositions == other.splitPositions;
+    }
+
+    bool operator!=(const VertexLayout& other) const
+    {
+        return !(*this == other);
+    }
+
+    //Октаэдрическую нормаль разворачивает только compact.vert
+    bool NeedsDecode() const
+    {
+        return normal == NormalFormat::Oct16;
+    }
+
+    //Байт на вершину по всем потокам
+    uint32_t GetStride() const
+    {
+        return positionSize() + normalSize() + colorSize() + texCoordSize();
+    }
+
+    std::vector<uint32_t> GetStreamStrides() const
+    {
+        if(splitPositions)
+            return {positionSize(), normalSize() + colorSize() + texCoordSize()};
+
+        return {GetStride()};
+    }
+
+    //positionsOnly - для пайплайнов глубины/теней: один binding и одна локация
+    std::vector<VkVertexInputBindingDescription> GetBindingDescriptions(bool positionsOnly = false) const
+    {
+        std::vector<uint32_t> strides = GetStreamStrides();
+
+        if(positionsOnly)
+            strides.resize(1);
+
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions(strides.size());
+        for(uint32_t i = 0; i < strides.size(); i++)
+        {
+            bindingDescriptions[i].binding = i;
+            bindingDescriptions[i].stride = strides[i];
+            bindingDescriptions[i].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        }
+
+        return bindingDescriptions;
+    }
+
+    //Локации те же, что в struct Vertex: 0 - позиция, 1 - нормаль, 2 - цвет, 3 - UV
+    std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions(bool positionsOnly = false) const
+    {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions(positionsOnly ? 1 : 4);
+
+        VkFormat formats[4] = {
+            position == PositionFormat::Float3 ? VK_FORMAT_R32G32B32_SFLOAT :
+                position == PositionFormat::Unorm16 ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R16G16B16A16_SFLOAT,
+            normal == NormalFormat::Float3 ? VK_FORMAT_R32G32B32_SFLOAT : VK_FORMAT_R16G16_SNORM,
+            color == ColorFormat::Float3 ? VK_FORMAT_R32G32B32_SFLOAT : VK_FORMAT_R8G8B8A8_UNORM,
+            texCoord == TexCoordFormat::Float2 ? VK_FORMAT_R32G32_SFLOAT : VK_FORMAT_R16G16_SFLOAT
+        };
+
+        uint32_t base = splitPositions ? 0 : positionSize();
+
+        uint32_t offsets[4] = {
+            0,
+            base,
+            base + normalSize(),
+            base + normalSize() + colorSize()
+        };
+
+        for(uint32_t i = 0; i < attributeDescriptions.size(); i++)
+        {
+            attributeDescriptions[i].binding = splitPositions && i > 0 ? 1 : 0;
+            attributeDescriptions[i].location = i;
+            attributeDescriptions[i].format = formats[i];
+            attributeDescriptions[i].offset = offsets[i];
+        }
+
+        return attributeDescriptions;
+    }
+
+    //Все форматы раскладки должны читаться из буфера вершин на этом устройстве
+    bool IsSupported(VkPhysicalDevice physicalDevice) const
+    {
+        for(auto& attribute : GetAttributeDescriptions())
+        {
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, attribute.format, &properties);
+
+            if(!(properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT))
+                return false;
+        }
+
+        return true;
+    }
+
+    //Матрица, переводящая сжатые позиции обратно в координаты меша; домножается справа к model
+    glm::mat4 GetDequantization(glm::vec3 min, glm::vec3 max) const
+    {
+        if(position == PositionFormat::Unorm16)
+            return glm::translate(glm::mat4(1.0f), min) * glm::scale(glm::mat4(1.0f), glm::max(max - min, glm::vec3(1e-6f)));
+        if(position == PositionFormat::Half)
+            return glm::translate(glm::mat4(1.0f), (min + max) * 0.5f);
+
+        return glm::mat4(1.0f);
+    }
+
+    //По буферу на поток, см. GetStreamStrides
+    std::vector<std::vector<uint8_t>> Encode(const std::vector<Vertex>& vertices, glm::vec3 min, glm::vec3 max) const
+    {
+        std::vector<uint32_t> strides = GetStreamStrides();
+
+        std::vector<std::vector<uint8_t>> streams(strides.size());
+        for(size_t i = 0; i < strides.size(); i++)
+            streams[i].resize(vertices.size() * strides[i]);
+
+        glm::vec3 extent = glm::max(max - min, glm::vec3(1e-6f));
+        glm::vec3 center = (min + max) * 0.5f;
+
+        for(size_t i = 0; i < vertices.size(); i++)
+        {
+            const Vertex& vertex = vertices[i];
+            uint8_t* out = streams[0].data() + i * strides[0];
+
+            if(position == PositionFormat::Float3)
+                out = write(out, vertex.pos);
+            else if(position == PositionFormat::Unorm16)
+            {
+                glm::vec3 p = glm::clamp((vertex.pos - min) / extent, 0.0f, 1.0f);
+                uint16_t q[4] = {glm::packUnorm1x16(p.x), glm::packUnorm1x16(p.y), glm::packUnorm1x16(p.z), glm::packUnorm1x16(1.0f)};
+                out = write(out, q);
+            }
+            else
+            {
+                glm::vec3 p = vertex.pos - center;
+                uint16_t q[4] = {glm::packHalf1x16(p.x), glm::packHalf1x16(p.y), glm::packHalf1x16(p.z), glm::packHalf1x16(1.0f)};
+                out = write(out, q);
+            }
+
+            if(splitPositions)
+                out = streams[1].data() + i * strides[1];
+
+            if(normal == NormalFormat::Float3)
+                out = write(out, vertex.normal);
+            else
+            {
+                glm::vec2 e = octEncode(vertex.normal);
+                uint16_t q[2] = {glm::packSnorm1x16(e.x), glm::packSnorm1x16(e.y)};
+                out = write(out, q);
+            }
+
+            if(color == ColorFormat::Float3)
+                out = write(out, vertex.color);
+            else
+            {
+                glm::vec3 c = glm::clamp(vertex.color, 0.0f, 1.0f);
+                uint8_t q[4] = {glm::packUnorm1x8(c.r), glm::packUnorm1x8(c.g), glm::packUnorm1x8(c.b), 255};
+                out = write(out, q);
+            }
+
+            if(texCoord == TexCoordFormat::Float2)
+                out = write(out, vertex.texCoord);
+            else
+            {
+                uint16_t q[2] = {glm::packHalf1x16(vertex.texCoord.x), glm::packHalf1x16(vertex.texCoord.y)};
+                out = write(out, q);
+            }
+        }
+
+        return streams;
+    }
+
+private:
+    uint32_t positionSize() const { return position == PositionFormat::Float3 ? 12 : 8; }
+    uint32_t normalSize() const { return normal == NormalFormat::Float3 ? 12 : 4; }
+    uint32_t colorSize() const { return color == ColorFormat::Float3 ? 12 : 4; }
+    uint32_t texCoordSize() const { return texCoord == TexCoordFormat::Float2 ? 8 : 4; }
+
+    template<typename T>
+    static uint8_t* write(uint8_t* out, const T& value)
+    {
+        memcpy(out, &value, sizeof(T));
+        return out + sizeof(T);
+    }
+
+    //Нормаль на октаэдр |x|+|y|+|z| = 1, нижняя половина отворачивается наружу
+    static glm::vec2 octEncode(glm::vec3 n)
+    {
+        float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if(sum <= 0.0f)
+            return glm::vec2(0.0f);
+
+        n /= sum;
+
+        glm::vec2 e(n.x, n.y);
+        if(n.z < 0.0f)
+        {
+            e = glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                          (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+        }
+
+        return e;
+    }
+};
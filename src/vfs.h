@@ -0,0 +1,81 @@
+#pragma once
+
+#include "stdinclude.h"
+
+#include "assetPack.h"
+
+#include <mutex>
+#include <unordered_set>
+
+//Единая точка чтения ассетов: сначала смонтированные паки (последний смонтированный важнее),
+//затем обычные файлы по тому же относительному пути. Монтировать до начала загрузок:
+//после этого список паков только читается и Open можно звать из рабочих потоков
+class Vfs{
+public:
+    static bool Mount(const std::string& packPath)
+    {
+        auto pack = std::make_shared<AssetPack>();
+        if(!pack->Load(packPath))
+            return false;
+
+        std::cout << packPath << ": mounted, " << pack->GetEntryCount() << " entries" << std::endl;
+
+        packs.insert(packs.begin(), pack);
+        return true;
+    }
+
+    static void Unmount()
+    {
+        packs.clear();
+    }
+
+    static bool Open(const std::string& path, MappedFile& file)
+    {
+        if(IsLoose(path))
+            return file.Open(path);
+
+        for(auto& pack : packs)
+            if(pack->Open(path, file))
+                return true;
+
+        return file.Open(path);
+    }
+
+    static bool Exists(const std::string& path)
+    {
+        for(auto& pack : packs)
+            if(pack->Find(path))
+                return true;
+
+        return std::ifstream(path, std::ios::binary).good();
+    }
+
+    //Файл изменён на диске после сборки пака (горячая перезагрузка): дальше он читается
+    //с диска, даже если есть в паке. Можно звать во время загрузок
+    static void PreferLoose(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(looseMutex);
+        loose.insert(AssetPack::NormalizePath(path));
+    }
+
+    static bool IsLoose(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(looseMutex);
+        return !loose.empty() && loose.count(AssetPack::NormalizePath(path)) > 0;
+    }
+
+    static std::vector<char> ReadFile(const std::string& path)
+    {
+        MappedFile file;
+        if(!Open(path, file))
+            throw std::runtime_error("failed to open file " + path + "!");
+
+        return std::vector<char>(file.GetData(), file.GetData() + file.GetSize());
+    }
+
+private:
+    inline static std::vector<std::shared_ptr<AssetPack>> packs;
+
+    inline static std::unordered_set<std::string> loose;
+    inline static std::mutex looseMutex;
+};
@@ -0,0 +1,161 @@
+//Сверка ObjParser с tinyobj::LoadObj: атрибуты и индексы треугольников должны совпадать до бита.
+//Сборка и запуск из корня репозитория:
+//  g++ -std=c++17 -O2 -Iinc -Isrc tests/objParser.cpp src/obj_loader/tiny_obj_loader.cpp -lpthread -o objParserTest
+//  ./objParserTest
+
+#include "stdinclude.h"
+#include "objParser.h"
+
+#include <random>
+#include <sstream>
+
+static bool compare(const std::string& name, const std::string& text, uint32_t threadCount)
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    std::istringstream stream(text);
+    tinyobj::MaterialStreamReader materialReader(stream);
+    if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream, &materialReader))
+    {
+        std::cout << name << ": tinyobj failed: " << err << std::endl;
+        return false;
+    }
+
+    ObjData data;
+    std::string error;
+    if(!ObjParser::Parse(text.data(), text.data() + text.size(), data, error, threadCount))
+    {
+        std::cout << name << ": ObjParser failed: " << error << std::endl;
+        return false;
+    }
+
+    std::vector<tinyobj::index_t> expected;
+    for(auto& shape : shapes)
+        expected.insert(expected.end(), shape.mesh.indices.begin(), shape.mesh.indices.end());
+
+    bool same = data.positions == attrib.vertices && data.normals == attrib.normals && data.texCoords == attrib.texcoords &&
+                data.indices.size() == expected.size();
+
+    for(size_t i = 0; same && i < expected.size(); i++)
+        same = data.indices[i].vertex == expected[i].vertex_index && data.indices[i].normal == expected[i].normal_index &&
+               data.indices[i].texCoord == expected[i].texcoord_index;
+
+    std::cout << (same ? "ok   " : "FAIL ") << name << ": " << data.positions.size() / 3 << " vertices, "
+              << expected.size() / 3 << " triangles (ObjParser " << data.indices.size() / 3 << ")" << std::endl;
+
+    return same;
+}
+
+static std::string crlf(const std::string& text)
+{
+    std::string out;
+    for(char c : text)
+    {
+        if(c == '\n')
+            out += '\r';
+        out += c;
+    }
+    return out;
+}
+
+//Случайные многоугольники, в том числе вогнутые и неплоские, с v/vt/vn и отрицательными индексами.
+//Размер больше нескольких MinChunkBytes, чтобы куски резались посреди файла
+static std::string generate(size_t minBytes)
+{
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::ostringstream out;
+    out.precision(6);
+
+    size_t vertexCount = 0;
+    while(static_cast<size_t>(out.tellp()) < minBytes)
+    {
+        int count = 3 + random() % 8;
+        bool concave = random() % 2;
+        float bend = random() % 3 == 0 ? 0.3f : 0.0f;
+        glm::vec3 center(unit(random) * 100.0f, unit(random) * 100.0f, unit(random) * 100.0f);
+
+        //Многоугольник в случайной плоскости, звезда - вогнутый, bend - неплоский
+        glm::vec3 u = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)));
+        glm::vec3 v = glm::normalize(glm::cross(u, glm::vec3(0.3f, 0.7f, 0.2f)));
+        glm::vec3 n = glm::cross(u, v);
+
+        for(int i = 0; i < count; i++)
+        {
+            float angle = 6.2831853f * i / count;
+            float radius = concave && i % 2 ? 0.4f : 1.0f;
+            glm::vec3 p = center + u * (std::cos(angle) * radius) + v * (std::sin(angle) * radius) + n * (bend * unit(random));
+
+            out << "v " << p.x << " " << p.y << " " << p.z << "\n";
+            out << "vt " << (unit(random) + 1.0f) * 0.5f << " " << (unit(random) + 1.0f) * 0.5f << "\n";
+            out << "vn " << n.x << " " << n.y << " " << n.z << "\n";
+        }
+
+        bool relative = random() % 2;
+        out << "f";
+        for(int i = 0; i < count; i++)
+        {
+            long index = relative ? i - count : static_cast<long>(vertexCount + i + 1);
+            out << " " << index << "/" << index << "/" << index;
+        }
+        out << "\n";
+
+        vertexCount += count;
+    }
+
+    return out.str();
+}
+
+int main()
+{
+    const std::string quads =
+        "# квадраты, разбиваются по короткой диагонали\n"
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 2 0 0\nv 2 3 0\n"
+        "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+        "f 1/1 2/2 3/3 4/4\n"
+        "f 2/2 5/1 6/3 3/4\n";
+
+    const std::string ngons =
+        "v 0 0 0\nv 2 0 0\nv 2 2 0\nv 1 0.5 0\nv 0 2 0\n"
+        "v 0 0 1\nv 1 0 1.2\nv 2 1 0.8\nv 1 2 1.1\nv 0 1 0.9\nv -1 0.5 1\n"
+        "v 0 0 0\nv 0 0 1\nv 0 1 1\nv 0 0.5 0.5\nv 0 1 0\n"
+        "# вогнутый пятиугольник, неплоский шестиугольник, пятиугольник в плоскости YZ\n"
+        "f 1 2 3 4 5\n"
+        "f 6 7 8 9 10 11\n"
+        "f 12 13 14 15 16\n";
+
+    const std::string normals =
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\n"
+        "vn 0 0 1\nvn 0 0 -1\n"
+        "f 1//1 2//1 3//1\n"
+        "f 2//2 4//2 3//2\n";
+
+    const std::string negative =
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+        "vt 0 0\nvt 1 1\n"
+        "vn 0 0 1\n"
+        "f -4/-2/-1 -3/-1/-1 -2/-1/-1 -1/-2/-1\n"
+        "v 5 5 5\nv 6 5 5\nv 6 6 5\n"
+        "f -3 -2 -1\n"
+        "f 1 -2 -1\n";
+
+    bool ok = true;
+
+    ok &= compare("quads", quads, 1);
+    ok &= compare("n-gons", ngons, 1);
+    ok &= compare("v//n", normals, 1);
+    ok &= compare("negative indices", negative, 1);
+    ok &= compare("CRLF", crlf(quads + ngons + normals), 1);
+
+    std::string big = generate(ObjParser::MinChunkBytes * 4 + 12345);
+    ok &= compare("random polygons, 1 thread", big, 1);
+    ok &= compare("random polygons, 4 threads", big, 4);
+    ok &= compare("random polygons, CRLF, 3 threads", crlf(big), 3);
+
+    std::cout << (ok ? "all passed" : "FAILED") << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}